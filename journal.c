@@ -0,0 +1,330 @@
+/* journal.c
+ * Persistent event journal for Powermate-mpd.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "./journal.h"
+
+#define JOURNAL_LENGTH (sizeof(struct journal_header) + \
+                        JOURNAL_RECORDS * sizeof(struct journal_record))
+
+static struct journal_header *journal = NULL;
+static struct journal_record *journal_records = NULL;
+static uint64_t journal_start = 0; // head of the JOURNAL_START of this run
+
+/*
+ * Fuction : journal_valid
+ * Desc    : A fuction that checks that a mapped journal header matches the
+ *           layout of this build and the length of the file.
+ * Inputs  :
+ *           struct *header - The mapped journal header.
+ *           size_t length  - The length of the journal file.
+ * Outputs : 1 when the journal is usable, 0 when it is not.
+ */
+static int journal_valid(const struct journal_header *header, size_t length) {
+
+   if (length < sizeof(struct journal_header)) {
+      return 0;
+   }
+
+   if (memcmp(header->magic,JOURNAL_MAGIC,sizeof(header->magic)) != 0 ||
+       header->version != JOURNAL_VERSION ||
+       header->record_size != sizeof(struct journal_record) ||
+       header->capacity == 0) {
+      return 0;
+   }
+
+   if (length < sizeof(struct journal_header) +
+       (size_t)header->capacity * sizeof(struct journal_record)) {
+      return 0;
+   }
+
+   return 1;
+}
+
+/*
+ * Fuction : journal_append
+ * Desc    : A fuction that copies one record into the journal ring. The
+ *           main thread and the MPD worker thread both write the journal,
+ *           each reserves its slot by increasing "head" atomically. A
+ *           reader may see "head" before the record is copied.
+ * Inputs  : struct *rec - The record.
+ * Outputs : The head of the record.
+ */
+static uint64_t journal_append(const struct journal_record *rec) {
+   uint64_t head = __atomic_fetch_add(&journal->head,1,__ATOMIC_ACQ_REL);
+
+   memcpy(&journal_records[head % JOURNAL_RECORDS],rec,sizeof(*rec));
+
+   return head;
+}
+
+/*
+ * Fuction : journal_open
+ * Desc    : A fuction that maps the journal file for writing. An existing
+ *           journal with the same layout is kept so that records from
+ *           earlier runs are still there after a restart.
+ * Inputs  : char *path - The journal file.
+ * Outputs : 0 on success, -1 on failure. Errors sent to syslog.
+ */
+int journal_open(const char *path) {
+   int fd;
+   void *map;
+   struct stat st;
+   struct timespec ts;
+   struct journal_record rec;
+
+   if (journal != NULL) {
+      journal_close();
+   }
+
+   fd = open(path, O_RDWR | O_CREAT,
+             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+   if (fd < 0) {
+      syslog(LOG_WARNING,"Can not open journal %s: %s",path,strerror(errno));
+      return -1;
+   }
+
+   if (fstat(fd,&st) < 0 || (size_t)st.st_size != JOURNAL_LENGTH) {
+      if (ftruncate(fd,0) < 0 || ftruncate(fd,JOURNAL_LENGTH) < 0) {
+         syslog(LOG_WARNING,"Can not size journal %s: %s",path,
+                strerror(errno));
+         close(fd);
+         return -1;
+      }
+   }
+
+   map = mmap(NULL,JOURNAL_LENGTH,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      syslog(LOG_WARNING,"Can not map journal %s: %s",path,strerror(errno));
+      return -1;
+   }
+
+   journal = map;
+   journal_records = (struct journal_record *)(journal + 1);
+
+   if (!journal_valid(journal,JOURNAL_LENGTH) ||
+       journal->capacity != JOURNAL_RECORDS) {
+      memset(journal,0,sizeof(struct journal_header));
+      memcpy(journal->magic,JOURNAL_MAGIC,sizeof(journal->magic));
+      journal->version = JOURNAL_VERSION;
+      journal->record_size = sizeof(struct journal_record);
+      journal->capacity = JOURNAL_RECORDS;
+   }
+
+   memset(&rec,0,sizeof(rec));
+   rec.kind = JOURNAL_START;
+   rec.value = getpid();
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   rec.time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+   clock_gettime(CLOCK_REALTIME,&ts);
+   rec.realtime_ns = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+   journal->start_realtime_ns = rec.realtime_ns;
+   journal->start_monotonic = rec.time_ns;
+
+   journal_start = journal_append(&rec);
+
+   return 0;
+}
+
+/*
+ * Fuction : journal_update_pid
+ * Desc    : A fuction that records the pid of the forked daemon in the
+ *           JOURNAL_START record of this run. The journal is opened before
+ *           the daemon forks.
+ * Inputs  : None
+ * Outputs : None
+ */
+void journal_update_pid(void) {
+
+   if (journal == NULL || journal->head - journal_start >= JOURNAL_RECORDS) {
+      return;
+   }
+
+   journal_records[journal_start % JOURNAL_RECORDS].value = getpid();
+}
+
+/*
+ * Fuction : journal_close
+ * Desc    : A fuction that unmaps the journal. Writes after the journal is
+ *           closed are ignored.
+ * Inputs  : None
+ * Outputs : None
+ */
+void journal_close(void) {
+
+   if (journal == NULL) {
+      return;
+   }
+
+   munmap(journal,JOURNAL_LENGTH);
+   journal = NULL;
+   journal_records = NULL;
+}
+
+/*
+ * Fuction : journal_write
+ * Desc    : A fuction that appends one record to the journal ring. The cost
+ *           is one clock read and one record copy into the mapped file, the
+ *           kernel writes the page back even when the process dies.
+ * Inputs  :
+ *           int kind   - JOURNAL_INPUT, GESTURE, MPD or LED.
+ *           int type   - Input event type, 0 for other kinds.
+ *           int code   - Input event code, gesture or MPD command.
+ *           int value  - Input event value or command argument.
+ *           int result - MPD command result.
+ * Outputs : None
+ */
+void journal_write(int kind, int type, int code, int value, int result) {
+   struct timespec ts;
+   struct journal_record rec;
+
+   if (journal == NULL) {
+      return;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+
+   rec.time_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+   rec.kind = kind;
+   rec.type = type;
+   rec.code = code;
+   rec.reserved = 0;
+   rec.value = value;
+   rec.result = result;
+   rec.realtime_ns = 0;
+
+   journal_append(&rec);
+}
+
+/*
+ * Fuction : journal_input
+ * Desc    : A fuction that appends a raw powermate input event to the journal.
+ * Inputs  : struct *ev - A input_event structure.
+ * Outputs : None
+ */
+void journal_input(const struct input_event *ev) {
+   journal_write(JOURNAL_INPUT,ev->type,ev->code,ev->value,0);
+}
+
+/*
+ * Fuction : journal_map
+ * Desc    : A fuction that maps a journal file read only. It is used by
+ *           the dump tool and by the replay mode.
+ * Inputs  :
+ *           char *path     - The journal file.
+ *           size_t *length - Set to the length of the mapping.
+ * Outputs : The mapped journal header, NULL when the file is not a journal.
+ */
+struct journal_header *journal_map(const char *path, size_t *length) {
+   int fd;
+   void *map;
+   struct stat st;
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return NULL;
+   }
+
+   if (fstat(fd,&st) < 0 || (size_t)st.st_size < sizeof(struct journal_header)) {
+      close(fd);
+      errno = EINVAL;
+      return NULL;
+   }
+
+   map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      return NULL;
+   }
+
+   if (!journal_valid(map,st.st_size)) {
+      munmap(map,st.st_size);
+      errno = EINVAL;
+      return NULL;
+   }
+
+   *length = st.st_size;
+   return map;
+}
+
+/*
+ * Fuction : journal_unmap
+ * Desc    : A fuction that unmaps a journal mapped by journal_map.
+ * Inputs  :
+ *           struct *header - The mapped journal header.
+ *           size_t length  - The length of the mapping.
+ * Outputs : None
+ */
+void journal_unmap(struct journal_header *header, size_t length) {
+   munmap(header,length);
+}
+
+/*
+ * Fuction : journal_count
+ * Desc    : A fuction that returns the number of records held in the ring
+ *           and takes the "head" snapshot journal_get reads them with, so
+ *           that the window does not move while a running daemon writes.
+ *           The newest record of the snapshot may still be being written,
+ *           and records the daemon writes during the read overwrite the
+ *           oldest ones.
+ * Inputs  :
+ *           struct *header - The mapped journal header.
+ *           uint64_t *head - The snapshot of "head".
+ * Outputs : The number of readable records.
+ */
+uint64_t journal_count(const struct journal_header *header, uint64_t *head) {
+   *head = __atomic_load_n(&header->head,__ATOMIC_ACQUIRE);
+
+   return *head < header->capacity ? *head : header->capacity;
+}
+
+/*
+ * Fuction : journal_get
+ * Desc    : A fuction that returns a record of the ring, oldest first.
+ * Inputs  :
+ *           struct *header - The mapped journal header.
+ *           uint64_t head  - The snapshot of journal_count.
+ *           uint64_t i     - Index from 0 to journal_count() - 1.
+ * Outputs : The record.
+ */
+const struct journal_record *journal_get(const struct journal_header *header,
+                                         uint64_t head, uint64_t i) {
+   const struct journal_record *records;
+   uint64_t first = head < header->capacity ? 0 : head - header->capacity;
+
+   records = (const struct journal_record *)(header + 1);
+   return &records[(first + i) % header->capacity];
+}
@@ -0,0 +1,107 @@
+/* journal.h
+* Persistent event journal for Powermate-mpd.
+*
+* Version: 2.1.0
+* Author:  Matthew J Wolf
+* Date:    19-OCT-2026
+* This file is part of Powermate-mpd.
+* By Matthew J. Wolf <mwolf@speciosus.net>
+* Copyright 2018 Matthew J. Wolf
+*
+* Powermate-mpd is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by the
+* the Free Software Foundation,either version 2 of the License,
+* or (at your option) any later version.
+*
+* Powermate-mpd is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with the HPSDR-USB Plug-in for Wireshark.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#ifndef POWERMATE_JOURNAL_H
+#define POWERMATE_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/input.h>
+
+#define JOURNALFILE "/usr/local/var/log/powermate-mpd.journal"
+
+#define JOURNAL_MAGIC "PMMPDJNL"
+#define JOURNAL_VERSION 2
+#define JOURNAL_RECORDS 4096
+
+// Record kinds
+#define JOURNAL_START   0 // value: daemon pid, realtime_ns: clock anchor
+#define JOURNAL_INPUT   1
+#define JOURNAL_GESTURE 2
+#define JOURNAL_MPD     3
+#define JOURNAL_LED     4 // value: powermate_led state
+
+// Decoded gestures, stored in the record code field.
+#define JOURNAL_GESTURE_BUTTON_DOWN 0
+#define JOURNAL_GESTURE_BUTTON_UP   1
+#define JOURNAL_GESTURE_TAP         2
+#define JOURNAL_GESTURE_LONG_PRESS  3
+#define JOURNAL_GESTURE_VOLUME      4
+#define JOURNAL_GESTURE_NEXT        5
+#define JOURNAL_GESTURE_PREVIOUS    6
+
+// MPD commands, stored in the record code field.
+// The record result field holds the libmpdclient "enum mpd_error".
+#define JOURNAL_MPD_CONNECT      0
+#define JOURNAL_MPD_STATUS       1
+#define JOURNAL_MPD_PLAY         2
+#define JOURNAL_MPD_STOP         3
+#define JOURNAL_MPD_TOGGLE_PAUSE 4
+#define JOURNAL_MPD_NEXT         5
+#define JOURNAL_MPD_PREVIOUS     6
+#define JOURNAL_MPD_VOLUME       7
+#define JOURNAL_MPD_IDLE         8
+
+// A JOURNAL_START record holds CLOCK_REALTIME next to its CLOCK_MONOTONIC
+// time stamp, the anchor that turns the time stamps of the run into
+// wall-clock times. Other records leave "realtime_ns" 0.
+struct journal_record {
+   uint64_t time_ns;     // CLOCK_MONOTONIC
+   uint16_t kind;
+   uint16_t type;
+   uint16_t code;
+   uint16_t reserved;
+   int32_t value;
+   int32_t result;
+   int64_t realtime_ns;  // CLOCK_REALTIME, JOURNAL_START only
+};
+
+// The file is the header followed by "capacity" records used as a ring.
+// "head" counts every record ever written, the next slot is
+// head % capacity.
+struct journal_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t record_size;
+   uint32_t capacity;
+   uint32_t reserved;
+   uint64_t head;
+   int64_t start_realtime_ns; // CLOCK_REALTIME ns of the last open
+   uint64_t start_monotonic;  // CLOCK_MONOTONIC ns of the last open
+};
+
+int journal_open(const char *path);
+void journal_close(void);
+void journal_update_pid(void);
+void journal_write(int kind, int type, int code, int value, int result);
+void journal_input(const struct input_event *ev);
+
+struct journal_header *journal_map(const char *path, size_t *length);
+void journal_unmap(struct journal_header *header, size_t length);
+uint64_t journal_count(const struct journal_header *header, uint64_t *head);
+const struct journal_record *journal_get(const struct journal_header *header,
+                                         uint64_t head, uint64_t i);
+
+#endif
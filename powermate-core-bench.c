@@ -0,0 +1,146 @@
+/* powermate-core-bench.c
+ * Microbenchmark of the Powermate-mpd event processing core.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/input.h>
+#include "./powermate-core.h"
+
+#define BENCH_EVENTS 10000000ULL
+
+// The bench is linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+// so that every allocation made while the core runs is counted.
+static unsigned long long allocations = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+   allocations++;
+   return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+   allocations++;
+   return __real_calloc(nmemb,size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+   allocations++;
+   return __real_realloc(ptr,size);
+}
+
+struct bench_event {
+   int type;
+   int code;
+   int value;
+   int advance; // ms the clock moves before the event
+};
+
+// One pass of a typical session: volume changes, a play list skip with the
+// button down, a tap and a long press. Each input event is followed by the
+// EV_SYN the kernel sends.
+static const struct bench_event pattern[] = {
+   { EV_REL, REL_DIAL,  1,    8 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_REL, REL_DIAL,  2,    8 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_REL, REL_DIAL, -1,    8 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     1,  100 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_REL, REL_DIAL,  1,   20 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_REL, REL_DIAL,  1,   20 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     0,  100 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     1,  500 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     0,  150 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     1,  500 }, { EV_SYN, SYN_REPORT, 0, 0 },
+   { EV_KEY, BTN_0,     0, 2500 }, { EV_SYN, SYN_REPORT, 0, 0 },
+};
+
+#define PATTERN_LENGTH (sizeof(pattern) / sizeof(pattern[0]))
+
+/*
+ * Fuction : main
+ * Desc    : Drives synthetic events through core_process_event.
+ * Inputs  : Optional number of events, the default is BENCH_EVENTS.
+ * Outputs : ns per event, actions and allocations sent to stdout.
+ */
+int main(int argc, char *argv[]) {
+   unsigned long long i, events = BENCH_EVENTS;
+   unsigned long long action_count = 0;
+   unsigned long long allocs;
+   unsigned long long elapsed;
+   uint64_t now = 0;
+   size_t p = 0;
+
+   struct powermate_core core;
+   struct core_action actions[CORE_MAX_ACTIONS];
+   struct input_event *evs;
+   struct timespec start, end;
+
+   if (argc > 1) {
+      events = strtoull(argv[1],NULL,10);
+   }
+
+   evs = calloc(PATTERN_LENGTH,sizeof(struct input_event));
+   if (evs == NULL) {
+      return EXIT_FAILURE;
+   }
+   for (p=0; p<PATTERN_LENGTH; p++) {
+      evs[p].type = pattern[p].type;
+      evs[p].code = pattern[p].code;
+      evs[p].value = pattern[p].value;
+   }
+
+   core_init(&core);
+   core.mpd_state = CORE_MPD_PLAY;
+
+   allocs = allocations;
+   clock_gettime(CLOCK_MONOTONIC,&start);
+
+   for (i=0, p=0; i<events; i++) {
+      now += pattern[p].advance;
+      action_count += core_process_event(&core,&evs[p],now,actions);
+      if (++p == PATTERN_LENGTH) {
+         p = 0;
+      }
+   }
+
+   clock_gettime(CLOCK_MONOTONIC,&end);
+   allocs = allocations - allocs;
+
+   elapsed = (unsigned long long)(end.tv_sec - start.tv_sec) * 1000000000ULL
+             + end.tv_nsec - start.tv_nsec;
+
+   printf("events:      %llu\n",events);
+   printf("actions:     %llu\n",action_count);
+   printf("time:        %llu ns\n",elapsed);
+   printf("ns/event:    %.2f\n",events ? (double)elapsed / events : 0.0);
+   printf("allocations: %llu\n",allocs);
+
+   free(evs);
+
+   return allocs == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,340 @@
+/* powermate-core-test.c
+ * Tests of the Powermate-mpd event processing core.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/input.h>
+#include "./powermate-core.h"
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond) do { \
+      checks++; \
+      if (!(cond)) { \
+         failures++; \
+         printf("%s:%d: %s: check failed: %s\n",__FILE__,__LINE__, \
+                __func__,#cond); \
+      } \
+   } while (0)
+
+// The actions of the last core call.
+static struct core_action actions[CORE_MAX_ACTIONS];
+static int n = 0;
+
+/*
+ * Fuction : event
+ * Desc    : A fuction that sends one input event through the core.
+ * Inputs  :
+ *           struct *core - The event processing state.
+ *           int type     - Input event type.
+ *           int code     - Input event code.
+ *           int value    - Input event value.
+ *           uint64_t now - The injected clock in milliseconds.
+ * Outputs : None, the actions are left in "actions" and "n".
+ */
+static void event(struct powermate_core *core, int type, int code, int value,
+                  uint64_t now) {
+   struct input_event ev;
+
+   memset(&ev,0,sizeof(ev));
+   ev.type = type;
+   ev.code = code;
+   ev.value = value;
+
+   n = core_process_event(core,&ev,now,actions);
+}
+
+/*
+ * Fuction : press
+ * Desc    : A fuction that presses the button at "down" and releases it at
+ *           "up". The actions of the release are left in "actions".
+ * Inputs  :
+ *           struct *core  - The event processing state.
+ *           uint64_t down - The time the button goes down.
+ *           uint64_t up   - The time the button goes up.
+ * Outputs : None
+ */
+static void press(struct powermate_core *core, uint64_t down, uint64_t up) {
+   event(core,EV_KEY,BTN_0,1,down);
+   event(core,EV_KEY,BTN_0,0,up);
+}
+
+/*
+ * Fuction : led
+ * Desc    : A fuction that returns the LED state the last core call set.
+ * Inputs  : None
+ * Outputs : The powermate_led state, -1 when the LED was not changed.
+ */
+static int led(void) {
+   int i;
+   int state = -1;
+
+   for (i=0; i<n; i++) {
+      if (actions[i].type == CORE_ACTION_LED) {
+         state = actions[i].value;
+      }
+   }
+
+   return state;
+}
+
+/*
+ * Fuction : has
+ * Desc    : A fuction that tells whether the last core call emitted an
+ *           action.
+ * Inputs  : int type - A CORE_ACTION type.
+ * Outputs : 1 when the action was emitted, 0 when it was not.
+ */
+static int has(int type) {
+   int i;
+
+   for (i=0; i<n; i++) {
+      if (actions[i].type == type) {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+/*
+ * Fuction : start
+ * Desc    : A fuction that sets up a core with a confirmed MPD state.
+ * Inputs  :
+ *           struct *core  - The event processing state.
+ *           int mpd_state - The CORE_MPD state.
+ * Outputs : None
+ */
+static void start(struct powermate_core *core, int mpd_state) {
+   core_init(core);
+   if (mpd_state != CORE_MPD_UNKNOWN) {
+      core_confirm(core,mpd_state,0,actions);
+   }
+}
+
+static void test_tap_while_playing(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1100);
+   CHECK(led() == CORE_LED_PAUSE);
+   CHECK(has(CORE_ACTION_TOGGLE_PAUSE));
+
+   n = core_confirm(&core,CORE_MPD_PAUSE,1150,actions);
+   CHECK(n == 0);
+   CHECK(core_timeout(&core,1150) == -1);
+
+   press(&core,2000,2100);
+   CHECK(led() == CORE_LED_ON);
+   n = core_confirm(&core,CORE_MPD_PLAY,2150,actions);
+   CHECK(n == 0);
+}
+
+static void test_tap_while_stopped(void) {
+   struct powermate_core core;
+
+   // MPD ignores a pause toggle while stopped, the LED stays off.
+   start(&core,CORE_MPD_STOP);
+   press(&core,1000,1100);
+   CHECK(led() == CORE_LED_OFF);
+   CHECK(has(CORE_ACTION_TOGGLE_PAUSE));
+
+   n = core_confirm(&core,CORE_MPD_STOP,1150,actions);
+   CHECK(n == 0);
+   CHECK(core_timeout(&core,1150) == -1);
+}
+
+static void test_long_press(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1000 + CORE_LONG_PRESS_MS);
+   CHECK(led() == CORE_LED_OFF);
+   CHECK(has(CORE_ACTION_STOP));
+   n = core_confirm(&core,CORE_MPD_STOP,3100,actions);
+   CHECK(n == 0);
+
+   press(&core,4000,4000 + CORE_LONG_PRESS_MS);
+   CHECK(led() == CORE_LED_ON);
+   CHECK(has(CORE_ACTION_PLAY));
+
+   // Paused playback is un-paused.
+   start(&core,CORE_MPD_PAUSE);
+   press(&core,1000,1000 + CORE_LONG_PRESS_MS);
+   CHECK(led() == CORE_LED_ON);
+   CHECK(has(CORE_ACTION_TOGGLE_PAUSE));
+
+   // Just short of a long press is a tap.
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1000 + CORE_LONG_PRESS_MS - 1);
+   CHECK(led() == CORE_LED_PAUSE);
+   CHECK(has(CORE_ACTION_TOGGLE_PAUSE));
+}
+
+static void test_long_press_unknown(void) {
+   struct powermate_core core;
+
+   // The executor asks MPD, the LED waits for the reported state.
+   start(&core,CORE_MPD_UNKNOWN);
+   press(&core,1000,1000 + CORE_LONG_PRESS_MS);
+   CHECK(led() == -1);
+   CHECK(has(CORE_ACTION_LONG_PRESS));
+
+   n = core_confirm(&core,CORE_MPD_PLAY,3100,actions);
+   CHECK(led() == CORE_LED_ON);
+   CHECK(core_timeout(&core,3100) == -1);
+}
+
+static void test_rotation_with_button(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   event(&core,EV_KEY,BTN_0,1,1000);
+   event(&core,EV_REL,REL_DIAL,1,1010);
+   CHECK(n == 0);
+   event(&core,EV_REL,REL_DIAL,1,1020);
+   CHECK(has(CORE_ACTION_NEXT));
+   event(&core,EV_KEY,BTN_0,0,1100);
+
+   // Releasing the button after a play list skip is not a tap.
+   CHECK(led() == -1);
+   CHECK(!has(CORE_ACTION_TOGGLE_PAUSE));
+
+   event(&core,EV_REL,REL_DIAL,-2,1200);
+   CHECK(has(CORE_ACTION_VOLUME));
+   CHECK(led() == -1);
+}
+
+static void test_mismatch(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1100);
+   CHECK(led() == CORE_LED_PAUSE);
+
+   // MPD kept playing.
+   n = core_confirm(&core,CORE_MPD_PLAY,1200,actions);
+   CHECK(led() == CORE_LED_ALERT);
+   CHECK(core_timeout(&core,1200) == CORE_MISMATCH_MS);
+
+   n = core_tick(&core,1200 + CORE_MISMATCH_MS - 1,actions);
+   CHECK(n == 0);
+   n = core_tick(&core,1200 + CORE_MISMATCH_MS,actions);
+   CHECK(led() == CORE_LED_ON);
+   CHECK(core_timeout(&core,1200 + CORE_MISMATCH_MS) == -1);
+}
+
+static void test_confirm_during_mismatch(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1100);
+   n = core_confirm(&core,CORE_MPD_PLAY,1200,actions);
+   CHECK(led() == CORE_LED_ALERT);
+
+   // A change reported while the mismatch shows is shown after it.
+   n = core_confirm(&core,CORE_MPD_STOP,1500,actions);
+   CHECK(n == 0);
+   n = core_tick(&core,1200 + CORE_MISMATCH_MS,actions);
+   CHECK(led() == CORE_LED_OFF);
+}
+
+static void test_fail_during_mismatch(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   press(&core,1000,1100);
+   n = core_confirm(&core,CORE_MPD_PLAY,1200,actions);
+   CHECK(led() == CORE_LED_ALERT);
+
+   // The failure pattern replaces the mismatch and does not time out.
+   n = core_fail(&core,actions);
+   CHECK(led() == CORE_LED_ALERT);
+   CHECK(core_timeout(&core,1300) == -1);
+   n = core_tick(&core,1200 + CORE_MISMATCH_MS,actions);
+   CHECK(n == 0);
+
+   n = core_confirm(&core,CORE_MPD_PLAY,5000,actions);
+   CHECK(led() == CORE_LED_ON);
+}
+
+static void test_fail_and_recover(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   n = core_fail(&core,actions);
+   CHECK(led() == CORE_LED_ALERT);
+   n = core_fail(&core,actions);
+   CHECK(n == 0);
+
+   n = core_confirm(&core,CORE_MPD_STOP,5000,actions);
+   CHECK(led() == CORE_LED_OFF);
+   n = core_confirm(&core,CORE_MPD_STOP,6000,actions);
+   CHECK(led() != CORE_LED_ALERT);
+}
+
+static void test_tap_after_fail(void) {
+   struct powermate_core core;
+
+   start(&core,CORE_MPD_PLAY);
+   n = core_fail(&core,actions);
+   CHECK(led() == CORE_LED_ALERT);
+
+   // The button shows the expected state, a second failure shows the
+   // failure pattern again.
+   press(&core,1000,1100);
+   CHECK(led() == CORE_LED_PAUSE);
+   n = core_fail(&core,actions);
+   CHECK(led() == CORE_LED_ALERT);
+
+   n = core_confirm(&core,CORE_MPD_PAUSE,3000,actions);
+   CHECK(led() == CORE_LED_PAUSE);
+}
+
+/*
+ * Fuction : main
+ * Desc    : Runs the core tests.
+ * Inputs  : None
+ * Outputs : Failed checks and a summary sent to stdout.
+ */
+int main(void) {
+
+   test_tap_while_playing();
+   test_tap_while_stopped();
+   test_long_press();
+   test_long_press_unknown();
+   test_rotation_with_button();
+   test_mismatch();
+   test_confirm_during_mismatch();
+   test_fail_during_mismatch();
+   test_fail_and_recover();
+   test_tap_after_fail();
+
+   printf("checks: %d failures: %d\n",checks,failures);
+
+   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,349 @@
+/* powermate-core.c
+ * Hardware independent PowerMate event processing for Powermate-mpd.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <string.h>
+#include <time.h>
+#include "./powermate-core.h"
+
+/*
+ * Fuction : core_init
+ * Desc    : A fuction that sets the initial event processing state.
+ * Inputs  : struct *core - The event processing state.
+ * Outputs : None
+ */
+void core_init(struct powermate_core *core) {
+   memset(core,0,sizeof(struct powermate_core));
+}
+
+/*
+ * Fuction : core_clock_ms
+ * Desc    : The clock the daemon passes to core_process_event.
+ * Inputs  : None
+ * Outputs : CLOCK_MONOTONIC in milliseconds.
+ */
+uint64_t core_clock_ms(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Fuction : core_expect
+ * Desc    : A fuction that records the MPD state a button action will lead
+ *           to and returns the LED action that shows it right away.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          int mpd_state    - The expected CORE_MPD state.
+ *          struct *action   - The LED action.
+ * Outputs : The number of actions written to "action".
+ */
+static int core_expect(struct powermate_core *core, int mpd_state,
+                       struct core_action *action) {
+   core->mpd_state = mpd_state;
+   core->expect = mpd_state;
+   core->alert_until = 0;
+   core->failed = 0;
+
+   action->type = CORE_ACTION_LED;
+   action->value = core_led(mpd_state);
+
+   return 1;
+}
+
+/*
+ * Fuction : core_tap
+ * Desc    : A fuction that pauses or un-pauses the playback for a short
+ *           button press.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          struct *actions  - Room for two actions.
+ * Outputs : The number of actions written to "actions".
+ */
+static int core_tap(struct powermate_core *core, struct core_action *actions) {
+   int n = 0;
+
+   switch (core->mpd_state) {
+   case CORE_MPD_PAUSE:
+      n += core_expect(core,CORE_MPD_PLAY,&actions[n]);
+      break;
+   case CORE_MPD_STOP:
+      // MPD ignores a pause toggle while stopped.
+      n += core_expect(core,CORE_MPD_STOP,&actions[n]);
+      break;
+   default:
+      n += core_expect(core,CORE_MPD_PAUSE,&actions[n]);
+      break;
+   }
+
+   actions[n].type = CORE_ACTION_TOGGLE_PAUSE;
+   actions[n++].value = 0;
+
+   return n;
+}
+
+/*
+ * Fuction : core_long_press
+ * Desc    : A fuction that starts or stops the playback for a long button
+ *           press. Paused playback is un-paused. When the MPD state is not
+ *           known the executor has to ask MPD first.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          struct *actions  - Room for two actions.
+ * Outputs : The number of actions written to "actions".
+ */
+static int core_long_press(struct powermate_core *core,
+                           struct core_action *actions) {
+   int n = 0;
+
+   switch (core->mpd_state) {
+   case CORE_MPD_STOP:
+      n += core_expect(core,CORE_MPD_PLAY,&actions[n]);
+      actions[n].type = CORE_ACTION_PLAY;
+      break;
+   case CORE_MPD_PLAY:
+      n += core_expect(core,CORE_MPD_STOP,&actions[n]);
+      actions[n].type = CORE_ACTION_STOP;
+      break;
+   case CORE_MPD_PAUSE:
+      n += core_expect(core,CORE_MPD_PLAY,&actions[n]);
+      actions[n].type = CORE_ACTION_TOGGLE_PAUSE;
+      break;
+   default:
+      actions[n].type = CORE_ACTION_LONG_PRESS;
+      break;
+   }
+   actions[n++].value = 1;
+
+   return n;
+}
+
+/*
+ * Fuction : core_process_event
+ * Desc    : A fuction that decides what to do for a powermate event. The
+ *           fuction only changes the event processing state and returns
+ *           actions, it does no I/O.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          struct *ev       - A input_event structure. The structure is defined
+ *                             in linux/input.h.
+ *          uint64_t now     - The time of the event in milliseconds.
+ *          struct *actions  - Array of at least CORE_MAX_ACTIONS actions.
+ * Outputs : The number of actions written to "actions".
+ */
+int core_process_event(struct powermate_core *core,
+                       const struct input_event *ev, uint64_t now,
+                       struct core_action *actions) {
+   int n = 0;
+
+   switch (ev->type) {
+   case EV_REL:
+      if (ev->code != REL_DIAL) {
+         break;
+      }
+
+      if (core->powermate_button == 1 ) {
+
+         // Rotation is too sensitive.
+         // Change Item in play list for every other rotation.
+         // Bitwise OR of random varies between two values (-1,0)
+         core->random = ~core->random;
+         if (core->random == 0) {
+
+            core->down_rot = 1;
+            if ((int)ev->value > 0) {
+               actions[n].type = CORE_ACTION_NEXT;
+               actions[n++].value = (int)ev->value;
+            } else if ((int)ev->value < 0) {
+               actions[n].type = CORE_ACTION_PREVIOUS;
+               actions[n++].value = (int)ev->value;
+            }
+         }
+      } else {
+         actions[n].type = CORE_ACTION_VOLUME;
+         actions[n++].value = (int)ev->value;
+      }
+      break;
+
+   case EV_KEY:
+      if (ev->code != BTN_0) {
+         break;
+      }
+
+      switch (ev->value) {
+      case 0:
+         actions[n].type = CORE_ACTION_BUTTON;
+         actions[n++].value = 0;
+         core->powermate_button = 0;
+         if (core->down_rot == 1) {
+            core->down_rot = 0;
+            break;
+         }
+
+         if (now - core->down_time >= CORE_LONG_PRESS_MS) {
+            n += core_long_press(core,&actions[n]);
+         } else {
+            n += core_tap(core,&actions[n]);
+         }
+         break;
+      case 1:
+         actions[n].type = CORE_ACTION_BUTTON;
+         actions[n++].value = 1;
+         core->powermate_button = 1;
+         core->down_time = now;
+         break;
+      }
+      break;
+   }
+
+   return n;
+}
+
+/*
+ * Fuction : core_confirm
+ * Desc    : A fuction that reconciles the LED with a MPD state that MPD
+ *           reported. When MPD is not in the state the LED already shows
+ *           for a button action, the LED shows CORE_LED_ALERT for
+ *           CORE_MISMATCH_MS before it shows the reported state.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          int mpd_state    - The CORE_MPD state reported by MPD.
+ *          uint64_t now     - The current time in milliseconds.
+ *          struct *actions  - Array of at least CORE_MAX_ACTIONS actions.
+ * Outputs : The number of actions written to "actions".
+ */
+int core_confirm(struct powermate_core *core, int mpd_state, uint64_t now,
+                 struct core_action *actions) {
+   int n = 0;
+
+   if (core_led(mpd_state) < 0) {
+      return 0;
+   }
+
+   if (core->expect != CORE_MPD_UNKNOWN && core->expect != mpd_state) {
+      core->alert_until = now + CORE_MISMATCH_MS;
+      actions[n].type = CORE_ACTION_LED;
+      actions[n++].value = CORE_LED_ALERT;
+   } else if (core->expect == CORE_MPD_UNKNOWN && core->alert_until == 0) {
+      actions[n].type = CORE_ACTION_LED;
+      actions[n++].value = core_led(mpd_state);
+   }
+
+   core->mpd_state = mpd_state;
+   core->expect = CORE_MPD_UNKNOWN;
+   core->failed = 0;
+
+   return n;
+}
+
+/*
+ * Fuction : core_fail
+ * Desc    : A fuction that handles a failed MPD contact or command. The LED
+ *           shows CORE_LED_ALERT until MPD reports its state again.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          struct *actions  - Array of at least CORE_MAX_ACTIONS actions.
+ * Outputs : The number of actions written to "actions".
+ */
+int core_fail(struct powermate_core *core, struct core_action *actions) {
+   int n = 0;
+
+   core->expect = CORE_MPD_UNKNOWN;
+   core->alert_until = 0;
+
+   if (!core->failed) {
+      core->failed = 1;
+      actions[n].type = CORE_ACTION_LED;
+      actions[n++].value = CORE_LED_ALERT;
+   }
+
+   return n;
+}
+
+/*
+ * Fuction : core_tick
+ * Desc    : A fuction that ends the mismatch LED pattern when it is due.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          uint64_t now     - The current time in milliseconds.
+ *          struct *actions  - Array of at least CORE_MAX_ACTIONS actions.
+ * Outputs : The number of actions written to "actions".
+ */
+int core_tick(struct powermate_core *core, uint64_t now,
+              struct core_action *actions) {
+   int n = 0;
+
+   if (core->alert_until == 0 || now < core->alert_until) {
+      return 0;
+   }
+
+   core->alert_until = 0;
+   if (core_led(core->mpd_state) >= 0) {
+      actions[n].type = CORE_ACTION_LED;
+      actions[n++].value = core_led(core->mpd_state);
+   }
+
+   return n;
+}
+
+/*
+ * Fuction : core_timeout
+ * Desc    : A fuction that returns when core_tick has to be called next.
+ * Inputs  :
+ *          struct *core     - The event processing state.
+ *          uint64_t now     - The current time in milliseconds.
+ * Outputs : Milliseconds until core_tick is due, -1 when it is not needed.
+ */
+int64_t core_timeout(const struct powermate_core *core, uint64_t now) {
+
+   if (core->alert_until == 0) {
+      return -1;
+   }
+   if (now >= core->alert_until) {
+      return 0;
+   }
+
+   return (int64_t)(core->alert_until - now);
+}
+
+/*
+ * Fuction : core_led
+ * Desc    : A fuction that returns the LED state for a MPD state.
+ * Inputs  : int mpd_state - A CORE_MPD state.
+ * Outputs : The powermate_led state, -1 for an unknown MPD state.
+ */
+int core_led(int mpd_state) {
+
+   switch (mpd_state) {
+   case CORE_MPD_STOP:
+      return CORE_LED_OFF;
+   case CORE_MPD_PLAY:
+      return CORE_LED_ON;
+   case CORE_MPD_PAUSE:
+      return CORE_LED_PAUSE;
+   }
+
+   return -1;
+}
@@ -0,0 +1,96 @@
+/* powermate-core.h
+* Hardware independent PowerMate event processing for Powermate-mpd.
+*
+* Version: 2.1.0
+* Author:  Matthew J Wolf
+* Date:    19-OCT-2026
+* This file is part of Powermate-mpd.
+* By Matthew J. Wolf <mwolf@speciosus.net>
+* Copyright 2018 Matthew J. Wolf
+*
+* Powermate-mpd is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by the
+* the Free Software Foundation,either version 2 of the License,
+* or (at your option) any later version.
+*
+* Powermate-mpd is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with the HPSDR-USB Plug-in for Wireshark.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#ifndef POWERMATE_CORE_H
+#define POWERMATE_CORE_H
+
+#include <stdint.h>
+#include <linux/input.h>
+
+// A button press held at least this long is a long press.
+#define CORE_LONG_PRESS_MS 2000
+
+// How long the LED shows CORE_LED_ALERT after MPD did not do what the
+// LED already showed.
+#define CORE_MISMATCH_MS 1000
+
+// The most actions a core fuction emits for one call.
+#define CORE_MAX_ACTIONS 3
+
+// MPD player states, the same values as libmpdclient "enum mpd_state".
+#define CORE_MPD_UNKNOWN 0
+#define CORE_MPD_STOP    1
+#define CORE_MPD_PLAY    2
+#define CORE_MPD_PAUSE   3
+
+// powermate_led states
+#define CORE_LED_OFF   0
+#define CORE_LED_ON    1
+#define CORE_LED_PAUSE 3
+#define CORE_LED_ALERT 4 // Mismatch with MPD or MPD failure
+
+// Actions emitted by core_process_event
+#define CORE_ACTION_BUTTON       0 // value: 1 down, 0 up
+#define CORE_ACTION_VOLUME       1 // value: volume change
+#define CORE_ACTION_NEXT         2
+#define CORE_ACTION_PREVIOUS     3
+#define CORE_ACTION_TOGGLE_PAUSE 4 // value: 1 long press, 0 tap
+#define CORE_ACTION_LONG_PRESS   5 // Play or stop, the MPD state is unknown
+#define CORE_ACTION_LED          6 // value: powermate_led state
+#define CORE_ACTION_PLAY         7 // value: 1 long press
+#define CORE_ACTION_STOP         8 // value: 1 long press
+
+struct core_action {
+   int type;
+   int value;
+};
+
+// The LED shows "mpd_state" as soon as a button action is taken. "expect"
+// holds that state until MPD confirms it with core_confirm.
+struct powermate_core {
+   int powermate_button;
+   int down_rot;
+   int random;
+   uint64_t down_time;   // core clock ms
+   int mpd_state;        // Last confirmed or expected CORE_MPD state
+   int expect;           // Expected CORE_MPD state, CORE_MPD_UNKNOWN if none
+   int failed;           // The LED shows a MPD failure
+   uint64_t alert_until; // core clock ms, 0 when no mismatch is shown
+};
+
+void core_init(struct powermate_core *core);
+uint64_t core_clock_ms(void);
+int core_process_event(struct powermate_core *core,
+                       const struct input_event *ev, uint64_t now,
+                       struct core_action *actions);
+int core_confirm(struct powermate_core *core, int mpd_state, uint64_t now,
+                 struct core_action *actions);
+int core_fail(struct powermate_core *core, struct core_action *actions);
+int core_tick(struct powermate_core *core, uint64_t now,
+              struct core_action *actions);
+int64_t core_timeout(const struct powermate_core *core, uint64_t now);
+int core_led(int mpd_state);
+
+#endif
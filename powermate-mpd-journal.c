@@ -0,0 +1,205 @@
+/* powermate-mpd-journal.c
+ * Decodes the Powermate-mpd event journal.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <linux/input.h>
+#include "./journal.h"
+
+static const char *gesture_name[] = {
+   "button-down", "button-up", "tap", "long-press",
+   "volume", "next", "previous"
+};
+
+static const char *mpd_command_name[] = {
+   "connect", "status", "play", "stop", "toggle-pause",
+   "next", "previous", "volume", "idle"
+};
+
+// Indexed by libmpdclient "enum mpd_error".
+static const char *mpd_result_name[] = {
+   "ok", "oom", "argument", "state", "timeout",
+   "system", "resolver", "malformed", "closed", "server"
+};
+
+// Indexed by powermate_led state.
+static const char *led_name[] = { "off", "on", "on", "pause", "alert" };
+
+#define NAME(table, i) ((unsigned)(i) < sizeof(table) / sizeof(table[0]) ? \
+                        table[i] : "?")
+
+// The clock anchor of the run a record belongs to.
+struct run_anchor {
+   int known;
+   int64_t realtime_ns;  // CLOCK_REALTIME at "monotonic_ns"
+   uint64_t monotonic_ns;
+};
+
+/*
+ * Fuction : print_time
+ * Desc    : A fuction that prints the wall-clock time of a record. The time
+ *           is not known for the records of a run whose JOURNAL_START
+ *           record was overwritten.
+ * Inputs  :
+ *           struct *anchor - The clock anchor of the run.
+ *           uint64_t ns    - The CLOCK_MONOTONIC time stamp of the record.
+ * Outputs : The time sent to stdout.
+ */
+static void print_time(const struct run_anchor *anchor, uint64_t ns) {
+   int64_t realtime;
+   time_t sec;
+   struct tm tm;
+   char buf[32];
+
+   if (!anchor->known) {
+      printf("%-23s ","(time unknown)");
+      return;
+   }
+
+   realtime = anchor->realtime_ns + (int64_t)(ns - anchor->monotonic_ns);
+   sec = realtime / 1000000000LL;
+   localtime_r(&sec,&tm);
+   strftime(buf,sizeof(buf),"%Y-%m-%d %H:%M:%S",&tm);
+   printf("%s.%03d ",buf,(int)(realtime % 1000000000LL / 1000000));
+}
+
+/*
+ * Fuction : print_record
+ * Desc    : A fuction that prints one decoded journal record.
+ * Inputs  :
+ *           struct *anchor - The clock anchor of the run.
+ *           struct *rec    - The journal record.
+ * Outputs : One line sent to stdout.
+ */
+static void print_record(const struct run_anchor *anchor,
+                         const struct journal_record *rec) {
+
+   print_time(anchor,rec->time_ns);
+   printf("%6llu.%06llu ",
+          (unsigned long long)(rec->time_ns / 1000000000ULL),
+          (unsigned long long)(rec->time_ns % 1000000000ULL) / 1000);
+
+   switch (rec->kind) {
+   case JOURNAL_START:
+      printf("START   pid=%d\n",rec->value);
+      break;
+   case JOURNAL_INPUT:
+      if (rec->type == EV_REL && rec->code == REL_DIAL) {
+         printf("INPUT   EV_REL REL_DIAL %d\n",rec->value);
+      } else if (rec->type == EV_KEY && rec->code == BTN_0) {
+         printf("INPUT   EV_KEY BTN_0 %d\n",rec->value);
+      } else if (rec->type == EV_SYN) {
+         printf("INPUT   EV_SYN %d %d\n",rec->code,rec->value);
+      } else {
+         printf("INPUT   type=%d code=%d value=%d\n",
+                rec->type,rec->code,rec->value);
+      }
+      break;
+   case JOURNAL_GESTURE:
+      printf("GESTURE %s %d\n",NAME(gesture_name,rec->code),rec->value);
+      break;
+   case JOURNAL_MPD:
+      printf("MPD     %s %d -> %s\n",NAME(mpd_command_name,rec->code),
+             rec->value,NAME(mpd_result_name,rec->result));
+      break;
+   case JOURNAL_LED:
+      printf("LED     %s\n",NAME(led_name,rec->value));
+      break;
+   default:
+      printf("UNKNOWN kind=%d\n",rec->kind);
+      break;
+   }
+}
+
+/*
+ * Fuction : main
+ * Desc    : The main fuction of the journal dump tool.
+ * Inputs  : Optional journal file, the default is JOURNALFILE.
+ * Outputs : The decoded journal sent to stdout, errors sent to stderr.
+ */
+int main(int argc, char *argv[]) {
+   const char *path = JOURNALFILE;
+   struct journal_header *header;
+   const struct journal_record *rec;
+   struct run_anchor anchor;
+   time_t start;
+   size_t length;
+   uint64_t i, count, head;
+
+   if (argc > 1) {
+      if (!strcmp("--help",argv[1])) {
+         printf("\nusage: powermate-mpd-journal [journal file]\n"
+                "      Default: %s\n\n",JOURNALFILE);
+         return EXIT_SUCCESS;
+      }
+      path = argv[1];
+   }
+
+   header = journal_map(path,&length);
+   if (header == NULL) {
+      fprintf(stderr,"Can not read journal %s: %s\n",path,strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   count = journal_count(header,&head);
+   start = (time_t)(header->start_realtime_ns / 1000000000LL);
+
+   printf("# %s: %llu of %llu records, last start %s",path,
+          (unsigned long long)count,(unsigned long long)head,
+          ctime(&start));
+   printf("# last start monotonic %llu.%06llu\n",
+          (unsigned long long)(header->start_monotonic / 1000000000ULL),
+          (unsigned long long)(header->start_monotonic % 1000000000ULL) / 1000);
+
+   // Records before the first JOURNAL_START belong to the last run when
+   // the ring holds no JOURNAL_START, otherwise to an earlier run whose
+   // JOURNAL_START was overwritten.
+   anchor.known = 1;
+   anchor.realtime_ns = header->start_realtime_ns;
+   anchor.monotonic_ns = header->start_monotonic;
+   for (i=0; i<count; i++) {
+      if (journal_get(header,head,i)->kind == JOURNAL_START) {
+         anchor.known = 0;
+         break;
+      }
+   }
+
+   for (i=0; i<count; i++) {
+      rec = journal_get(header,head,i);
+      if (rec->kind == JOURNAL_START) {
+         anchor.known = 1;
+         anchor.realtime_ns = rec->realtime_ns;
+         anchor.monotonic_ns = rec->time_ns;
+      }
+      print_record(&anchor,rec);
+   }
+
+   journal_unmap(header,length);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/* powermate-mpd-state.c
+ * Prints the MPD state published by Powermate-mpd.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "./powermate-state.h"
+
+// Indexed by libmpdclient "enum mpd_state".
+static const char *state_name[] = { "unknown", "stop", "play", "pause" };
+
+#define STATE_PLAY 2
+
+/*
+ * Fuction : main
+ * Desc    : The main fuction of the state print program.
+ * Inputs  : Optional state file, the default is STATEFILE.
+ * Outputs : The state as "name=value" lines sent to stdout,
+ *           errors sent to stderr.
+ */
+int main(int argc, char *argv[]) {
+   const char *path = STATEFILE;
+   const struct powermate_state *shared;
+   struct powermate_state state;
+   struct stat st;
+   struct timespec ts;
+   uint64_t now;
+   int64_t position;
+   uint32_t seq;
+   void *map;
+   int fd;
+
+   if (argc > 1) {
+      if (!strcmp("--help",argv[1])) {
+         printf("\nusage: powermate-mpd-state [state file]\n"
+                "      Default: %s\n\n",STATEFILE);
+         return EXIT_SUCCESS;
+      }
+      path = argv[1];
+   }
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr,"Can not open state file %s: %s\n",path,strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   // Reading past the end of a short file raises SIGBUS.
+   if (fstat(fd,&st) < 0) {
+      fprintf(stderr,"Can not stat state file %s: %s\n",path,strerror(errno));
+      close(fd);
+      return EXIT_FAILURE;
+   }
+   if ((size_t)st.st_size < sizeof(struct powermate_state)) {
+      fprintf(stderr,"%s is not a powermate-mpd state file\n",path);
+      close(fd);
+      return EXIT_FAILURE;
+   }
+
+   map = mmap(NULL,sizeof(struct powermate_state),PROT_READ,MAP_SHARED,fd,0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      fprintf(stderr,"Can not map state file %s: %s\n",path,strerror(errno));
+      return EXIT_FAILURE;
+   }
+   shared = map;
+
+   // The daemon died in the middle of an update, it repairs the file when
+   // it starts again.
+   if (powermate_state_read(shared,&state,&seq) < 0) {
+      fprintf(stderr,"%s is stale, an update of the daemon was cut short\n",
+              path);
+      munmap(map,sizeof(struct powermate_state));
+      return EXIT_FAILURE;
+   }
+
+   if (memcmp(state.magic,STATE_MAGIC,sizeof(state.magic)) ||
+       state.version != STATE_VERSION) {
+      fprintf(stderr,"%s is not a powermate-mpd state file\n",path);
+      munmap(map,sizeof(struct powermate_state));
+      return EXIT_FAILURE;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+   // The play time moves on from elapsed_ms while MPD plays.
+   position = state.elapsed_ms;
+   if (state.state == STATE_PLAY && state.connected &&
+       state.elapsed_at_ms != 0) {
+      clock_gettime(CLOCK_REALTIME,&ts);
+      position += (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000
+                  - state.elapsed_at_ms;
+   }
+
+   printf("seq=%u\n",seq);
+   printf("state=%s\n",(unsigned)state.state < 4 ?
+          state_name[state.state] : "unknown");
+   printf("volume=%d\n",state.volume);
+   printf("song_id=%d\n",state.song_id);
+   printf("elapsed_ms=%u\n",state.elapsed_ms);
+   printf("elapsed_at_ms=%lld\n",(long long)state.elapsed_at_ms);
+   printf("position_ms=%lld\n",(long long)position);
+   printf("connected=%u\n",state.connected);
+   printf("failures=%u\n",state.failures);
+   printf("age_ms=%llu\n",now > state.updated_ns ?
+          (unsigned long long)(now - state.updated_ns) / 1000000 : 0ULL);
+
+   munmap(map,sizeof(struct powermate_state));
+
+   return EXIT_SUCCESS;
+}
@@ -26,6 +26,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,10 +40,17 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include "./journal.h"
+#include "./powermate-core.h"
 #include "./powermate-mpd.h"
+#include "./powermate-net.h"
+#include "./powermate-state.h"
 
 int debug = 0;
 
+// The SIGTERM or SIGINT that ends monitor_powermate_mpd, 0 while running.
+volatile sig_atomic_t exit_signal = 0;
+
 pid_t pid, sid;
 FILE *pidfile;
 
@@ -61,6 +70,10 @@ int main(int argc, char *argv[]) {
    int fd_powermate = -1;
 
    const char *mpd_error;
+   const char *host = NULL;
+   const char *journal_path = JOURNALFILE;
+   const char *replay_path = NULL;
+   const char *state_path = STATEFILE;
 
    struct mpd_connection *mpd_conn = NULL;
    struct mpd_status *mpd_status = NULL;
@@ -68,12 +81,13 @@ int main(int argc, char *argv[]) {
    struct items_status *status = malloc(sizeof(struct items_status));
 
    // Set status struc initial values
-   strcpy(status->host,"::1"); // MPD host
-   status->port = 6600; //default MPD port
-   status->powermate_button = 0;
-   status->down_rot = 0;
-   status->mpd_paused = 0;
-   status->random = 0;
+   // The MPD host and port are set by mpd_host_settings.
+   status->host = NULL;
+   status->password = NULL;
+   status->port = 0;
+   status->request_id = 0;
+   status->reply_id = 0;
+   core_init(&status->core);
 
    for ( i=1; i < argc; i++ ) {
       if (!strcmp("-d",argv[i])) {
@@ -82,7 +96,7 @@ int main(int argc, char *argv[]) {
       if (!strcmp("-h",argv[i])) {
          // MPD host
          if ( argv[i+1] != '\0' ) {
-            strcpy(status->host,argv[i+1]);
+            host = argv[i+1];
          }
       }
       if (!strcmp("-p",argv[i])) {
@@ -100,29 +114,64 @@ int main(int argc, char *argv[]) {
             }
          }
       }
+      if (!strcmp("-j",argv[i])) {
+         // Event journal file
+         if ( i+1 < argc ) {
+            journal_path = argv[i+1];
+         }
+      }
+      if (!strcmp("-s",argv[i])) {
+         // Player state file
+         if ( i+1 < argc ) {
+            state_path = argv[i+1];
+         }
+      }
+      if (!strcmp("-r",argv[i])) {
+         // Replay the input events of a journal file
+         if ( i+1 < argc ) {
+            replay_path = argv[i+1];
+         }
+      }
       if (!strcmp("--help",argv[i])) {
          // Display Usage
-         printf("\nusage: powermate-mpd -dhpP --help\n"
+         printf("\nusage: powermate-mpd -dhpPjsr --help\n"
                 "----------------------------------------------\n"
                 "-d Debug\n"
                 "      Does not daemonize and displays messages\n"
-                "-h MPD Host IP Address\n"
-                "      Default: %s\n"
+                "-h MPD Host, Unix Socket Path or password@host\n"
+                "      Default: MPD_HOST, %s when present or %s\n"
                 "-p MPD Host Service Port\n"
-                "      Default: %d\n"
+                "      Default: MPD_PORT or %d\n"
                 "-P MPD Polling Interval (Seconds)\n"
                 "      Default and Minimum is 10 seconds\n"
+                "-j Event Journal File\n"
+                "      Default: %s\n"
+                "-s Player State File\n"
+                "      Default: %s\n"
+                "-r Replay the input events of a journal file\n"
+                "      Prints the actions, does not use MPD or the powermate\n"
                 "--help Display the program usage details\n\n"
-                ,status->host,status->port);
+                ,MPD_SOCKET,MPD_DEFAULT_HOST,MPD_DEFAULT_PORT,
+                JOURNALFILE,STATEFILE);
          return EXIT_SUCCESS;
       }
    }
 
+   if (replay_path != NULL) {
+      // Replay mode, MPD and the powermate are not used.
+      return replay_journal(replay_path,&status->core);
+   }
+
+   mpd_host_settings(status,host);
+   status->poll = poll;
+
    if (debug) {printf("Host: %s Port: %d Poll: %d\n",status->host,
                       status->port,poll); }
 
    openlog("powermate-mpd",LOG_PID, LOG_DAEMON);
 
+   journal_open(journal_path);
+   state_open(state_path);
    // Open Powermate read and write.
    fd_powermate = find_powermate(O_RDWR);
    if (fd_powermate < 0) {
@@ -132,11 +181,21 @@ int main(int argc, char *argv[]) {
    }
 
    // Set Powermate LED when the program starts
-   mpd_conn = mpd_connection_new(status->host, status->port, 30000);
-   mpd_send_status(mpd_conn);
-   mpd_status = mpd_recv_status(mpd_conn);
+   // Resolve a MPD host name once before the background resolver runs.
+   if (!MPD_HOST_IS_SOCKET(status->host) &&
+       net_init(status->host,status->port) <= 0) {
+      fprintf(stderr, "Unable to resolve MPD host %s.\n", status->host);
+      syslog(LOG_ERR,"Unable to resolve MPD host %s.", status->host);
+      exit (EXIT_FAILURE);
+   }
 
-   if (mpd_connection_get_error(mpd_conn) != MPD_ERROR_SUCCESS) {
+   mpd_conn = mpd_connect(status);
+   if (mpd_conn == NULL) {
+      exit (EXIT_FAILURE);
+   }
+
+   mpd_status = mpd_query_status(mpd_conn);
+   if (mpd_status == NULL) {
       mpd_error = mpd_connection_get_error_message(mpd_conn);
       fprintf(stderr, "Error: mpd connection: %s\n", mpd_error);
       syslog(LOG_ERR,"Error: mpd connection: %s", mpd_error);
@@ -147,78 +206,262 @@ int main(int argc, char *argv[]) {
    switch (mpd_status_get_state(mpd_status)) {
    case MPD_STATE_STOP:
       if (debug) { printf("STOP LED Off\n"); }
-      powermate_led(fd_powermate,0);
+      status->core.mpd_state = CORE_MPD_STOP;
+      powermate_led(fd_powermate,CORE_LED_OFF);
       break;
    case MPD_STATE_PLAY:
       if (debug) { printf("Play LED On\n"); }
-      powermate_led(fd_powermate,1);
+      status->core.mpd_state = CORE_MPD_PLAY;
+      powermate_led(fd_powermate,CORE_LED_ON);
       break;
    case MPD_STATE_PAUSE:
       // Changes from paused to play.
       if (debug) { printf("Paused to Play: LED On\n"); }
-      powermate_led(fd_powermate,1);
+      status->core.mpd_state = CORE_MPD_PLAY;
+      powermate_led(fd_powermate,CORE_LED_ON);
       mpd_send_toggle_pause(mpd_conn);
+      mpd_command_result(mpd_conn,JOURNAL_MPD_TOGGLE_PAUSE,0);
       break;
    case MPD_STATE_UNKNOWN:
       break;
    }
 
+   mpd_status_free(mpd_status);
    mpd_connection_free(mpd_conn);
 
    // Fork Daemon
    if (!debug) {
       daemonize();
+      journal_update_pid();
+   } else {
+      // Clear the state file on Ctrl-C too.
+      set_signal_handler();
+   }
+
+   // The resolver and MPD threads are started after the fork, threads do
+   // not survive fork().
+   if (!MPD_HOST_IS_SOCKET(status->host)) {
+      net_start();
+   }
+   if (mpd_worker_start(status) < 0) {
+      exit (EXIT_FAILURE);
    }
 
-   monitor_powermate_mpd(fd_powermate,poll,status);
+   monitor_powermate_mpd(fd_powermate,status);
 
    close(fd_powermate);
+   state_close();
+
+   if (exit_signal != 0) {
+      syslog(LOG_NOTICE,"Received %s: Exiting",
+             exit_signal == SIGTERM ? "SIGTERM" : "SIGINT");
+      unlink(LOCKFILE);
+   }
 
    exit(EXIT_SUCCESS);
 }
 
+/*
+ * Fuction : mpd_host_settings
+ * Desc    : A fuction that sets the MPD host, password and port. The host is
+ *           taken from the -h argument, the MPD_HOST environment variable,
+ *           the local MPD socket when it exists, or the IPv6 loop-back
+ *           address, in that order. A host of the form password@host
+ *           also sets the password. The port is not used for sockets.
+ * Inputs  :
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h
+ *          char *host       - The -h argument, NULL when not given.
+ * Outputs : None
+ */
+void mpd_host_settings(struct items_status *status, const char *host) {
+   const char *at;
+   const char *port;
+
+   struct stat st;
+
+   if (host == NULL) {
+      host = getenv("MPD_HOST");
+   }
+
+   if (host != NULL && host[0] != '\0') {
+      // A leading '@' is an abstract socket, not a password.
+      at = strchr(host,'@');
+      if (at != NULL && at != host) {
+         status->password = strndup(host,at-host);
+         host = at+1;
+      }
+      status->host = strdup(host);
+   } else if (stat(MPD_SOCKET,&st) == 0 && S_ISSOCK(st.st_mode)) {
+      status->host = strdup(MPD_SOCKET);
+   } else {
+      status->host = strdup(MPD_DEFAULT_HOST);
+   }
+
+   if (status->host == NULL) {
+      fprintf(stderr, "strdup(): %s\n", strerror(errno));
+      syslog(LOG_ERR,"strdup(): %s", strerror(errno));
+      exit (EXIT_FAILURE);
+   }
+
+   if (MPD_HOST_IS_SOCKET(status->host)) {
+      status->port = 0;
+      return;
+   }
+
+   if (status->port == 0) {
+      port = getenv("MPD_PORT");
+      if (port != NULL && port[0] != '\0') {
+         status->port = AsciiDecCharToInt((char *)port,0,(int)strlen(port));
+      }
+   }
+   if (status->port <= 0) {
+      status->port = MPD_DEFAULT_PORT;
+   }
+}
+
+/*
+ * Fuction : mpd_connect
+ * Desc    : A fuction that connects to MPD and sends the password when one
+ *           is set. Unix sockets are opened by libmpdclient. For a TCP host
+ *           the cached addresses of the background resolver are used and
+ *           all of them are raced by net_connect, so that the fuction never
+ *           waits for DNS and only as long as the fastest working address.
+ * Inputs  :
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h
+ * Outputs : The MPD connection that the caller frees, NULL on failure.
+ *           Errors sent to stderr and syslog.
+ */
+struct mpd_connection *mpd_connect(struct items_status *status) {
+   int n = 0;
+   int fd = -1;
+   int winner = 0;
+   char welcome[256];
+
+   const char *mpd_error = NULL;
+   enum mpd_error result = MPD_ERROR_SUCCESS;
+
+   struct net_addr addrs[NET_MAX_ADDRS];
+   struct mpd_async *mpd_async = NULL;
+   struct mpd_connection *mpd_conn = NULL;
+
+   if (MPD_HOST_IS_SOCKET(status->host)) {
+      mpd_conn = mpd_connection_new(status->host, 0, 30000);
+   } else {
+      n = net_lookup(addrs,NET_MAX_ADDRS);
+      fd = net_connect(addrs,n,NET_CONNECT_TIMEOUT_MS,&winner);
+      if (n == 0) {
+         result = MPD_ERROR_RESOLVER;
+         mpd_error = "MPD host is not resolved";
+      } else if (fd < 0) {
+         result = errno == ETIMEDOUT ? MPD_ERROR_TIMEOUT : MPD_ERROR_SYSTEM;
+         mpd_error = strerror(errno);
+      } else if (net_read_line(fd,welcome,sizeof(welcome),
+                               NET_CONNECT_TIMEOUT_MS) < 0 ||
+                 (mpd_async = mpd_async_new(fd)) == NULL) {
+         result = MPD_ERROR_SYSTEM;
+         mpd_error = strerror(errno);
+         close(fd);
+      } else {
+         net_prefer(&addrs[winner]);
+         mpd_conn = mpd_connection_new_async(mpd_async,welcome);
+         if (mpd_conn != NULL) {
+            mpd_connection_set_timeout(mpd_conn,30000);
+         }
+      }
+   }
+
+   if (mpd_conn != NULL) {
+      if (status->password != NULL &&
+          mpd_connection_get_error(mpd_conn) == MPD_ERROR_SUCCESS) {
+         mpd_run_password(mpd_conn, status->password);
+      }
+      result = mpd_connection_get_error(mpd_conn);
+      mpd_error = mpd_connection_get_error_message(mpd_conn);
+   } else if (result == MPD_ERROR_SUCCESS) {
+      result = MPD_ERROR_OOM;
+      mpd_error = "Out of memory";
+   }
+
+   if (result != MPD_ERROR_SUCCESS) {
+      fprintf(stderr, "Error: mpd connection: %s\n", mpd_error);
+      syslog(LOG_ERR,"Error: mpd connection: %s", mpd_error);
+      journal_write(JOURNAL_MPD,0,JOURNAL_MPD_CONNECT,0,result);
+      state_publish_failure();
+      if (mpd_conn != NULL) {
+         mpd_connection_free(mpd_conn);
+      }
+      return NULL;
+   }
+
+   return mpd_conn;
+}
+
 /*
  * Fuction : monitor_powermate_mpd
- * Desc    : A fuction that monitors the powermate device for state changes.
- *           The fuction calls other fuctions to process the new state / event.
+ * Desc    : A fuction that monitors the powermate device and the replies of
+ *           the MPD worker thread for state changes. The fuction calls
+ *           other fuctions to process the new state / event. It never
+ *           waits for MPD, MPD is only contacted by the worker thread.
+ *           SIGTERM and SIGINT are only let through while it waits, it
+ *           returns when one of them arrived.
  * Inputs  :
  *          int fd_powermate - The powermate file descriptor.
- *          int poll         - The polling interval in seconds.
  *          struct *status   - A items_status structure that is defined in
  *                             local powermate.h
  * Outputs : Errors sent to stderr and syslog.
  */
-void monitor_powermate_mpd(int fd_powermate,int poll,
-                           struct items_status *status) {
+void monitor_powermate_mpd(int fd_powermate,struct items_status *status) {
 
    int i = -1;
+   int n = 0;
    int rc = -1;
    int events = -1;
+   int fd_max = -1;
+   int64_t wait = -1;
 
    fd_set set;
 
    struct input_event ibuffer[BUFFER_SIZE];
-   struct timeval timeout;
+   struct core_action actions[CORE_MAX_ACTIONS];
+   struct timespec timeout;
+   sigset_t sigmask;
 
-   timeout.tv_sec = poll;
+   fd_max = fd_powermate > status->fd_reply ? fd_powermate : status->fd_reply;
+   sigemptyset(&sigmask);
 
-   for (;; ) {
+   while (exit_signal == 0) {
 
       // Need to reset the FD set before each select call.
       FD_ZERO(&set);
       FD_SET(fd_powermate,&set);
-      timeout.tv_sec = poll;
+      FD_SET(status->fd_reply,&set);
+
+      // Wake up when a LED mismatch pattern has to end.
+      wait = core_timeout(&status->core,core_clock_ms());
+      timeout.tv_sec = wait / 1000;
+      timeout.tv_nsec = (wait % 1000) * 1000000;
 
-      rc = select(fd_powermate+1,&set,NULL,NULL,&timeout);
+      rc = pselect(fd_max+1,&set,NULL,NULL,wait >= 0 ? &timeout : NULL,
+                   &sigmask);
 
       if ( rc == 0 ) { // Select Timeout
-         // Query MPD and update Powermate LED
          if (debug) { printf("Select Timeout\n"); }
-         powermate_led_state(fd_powermate,status);
+         n = core_tick(&status->core,core_clock_ms(),actions);
+         powermate_led_actions(fd_powermate,actions,n);
          continue;
       } else if ( rc == -1 ) {
+         if (errno == EINTR) {
+            continue;
+         }
          fprintf(stderr,"Select Error\n");
          syslog(LOG_ERR,"Select Error");
+         continue;
+      }
+
+      if (FD_ISSET(status->fd_reply,&set)) {
+         mpd_worker_reply(fd_powermate,status);
       }
 
       if (FD_ISSET(fd_powermate,&set)) {
@@ -227,6 +470,7 @@ void monitor_powermate_mpd(int fd_powermate,int poll,
          if ( rc > 0 ) {
             events = rc / sizeof(struct input_event);
             for (i=0; i<events; i++) {
+               journal_input(&ibuffer[i]);
                process_powermate_event(fd_powermate,&ibuffer[i],status);
             }
          } else {
@@ -242,195 +486,720 @@ void monitor_powermate_mpd(int fd_powermate,int poll,
 }
 
 /*
- * Fuction : powermate_led_state
- * Desc    : A fuction that changes the state of the powermate's LED.
+ * Fuction : process_powermate_event
+ * Desc    : A fuction that takes some action when the state of the powermate
+ *           changes. The decision is made by core_process_event. The LED is
+ *           changed at once, the MPD commands are handed to the MPD worker
+ *           thread. Its reply confirms or corrects the LED. The fuction
+ *           does not wait for MPD.
  * Inputs  :
  *          int fd           - The powermate file descriptor.
+ *          struct *ev       - A input_event structure. The structure is defined
+ *                             in linux/input.h.
  *          struct *status   - A items_status structure that is defined in
  *                             local powermate.h.
  * Outputs : Errors sent to stderr and syslog.
  */
-void powermate_led_state(int fd,struct items_status *status) {
-   const char *mpd_error;
+void process_powermate_event(int fd, struct input_event *ev,
+                             struct items_status *status) {
+
+   int i = -1;
+   int n = 0;
+
+   struct core_action actions[CORE_MAX_ACTIONS];
+   struct core_action led[CORE_MAX_ACTIONS];
+   struct worker_request request;
+
+   n = core_process_event(&status->core,ev,core_clock_ms(),actions);
+
+   request.n = 0;
+
+   for (i=0; i<n; i++) {
+      switch (actions[i].type) {
+      case CORE_ACTION_BUTTON:
+         if (debug) { printf("Button %s\n",actions[i].value ? "Down" : "UP"); }
+         journal_write(JOURNAL_GESTURE,0,actions[i].value ?
+                       JOURNAL_GESTURE_BUTTON_DOWN : JOURNAL_GESTURE_BUTTON_UP,
+                       0,0);
+         continue;
+      case CORE_ACTION_LED:
+         powermate_led_actions(fd,&actions[i],1);
+         continue;
+      case CORE_ACTION_VOLUME:
+         journal_write(JOURNAL_GESTURE,0,JOURNAL_GESTURE_VOLUME,
+                       actions[i].value,0);
+         break;
+      case CORE_ACTION_NEXT:
+         journal_write(JOURNAL_GESTURE,0,JOURNAL_GESTURE_NEXT,
+                       actions[i].value,0);
+         break;
+      case CORE_ACTION_PREVIOUS:
+         journal_write(JOURNAL_GESTURE,0,JOURNAL_GESTURE_PREVIOUS,
+                       actions[i].value,0);
+         break;
+      case CORE_ACTION_TOGGLE_PAUSE:
+         journal_write(JOURNAL_GESTURE,0,actions[i].value ?
+                       JOURNAL_GESTURE_LONG_PRESS : JOURNAL_GESTURE_TAP,0,0);
+         break;
+      default:
+         journal_write(JOURNAL_GESTURE,0,JOURNAL_GESTURE_LONG_PRESS,0,0);
+         break;
+      }
+      request.actions[request.n++] = actions[i];
+   }
+
+   if (request.n == 0) {
+      if (debug) { fflush(stdout); }
+      return;
+   }
+
+   // The request pipe is full when MPD has not answered for a long time.
+   request.id = status->request_id + 1;
+   if (write(status->fd_request,&request,sizeof(request)) != sizeof(request)) {
+      if (debug) { fprintf(stderr,"MPD request dropped: %s\n",
+                           strerror(errno)); }
+      n = core_fail(&status->core,led);
+      powermate_led_actions(fd,led,n);
+   } else {
+      status->request_id = request.id;
+   }
+   if (debug) { fflush(stdout); }
+}
+
+/*
+ * Fuction : mpd_worker_start
+ * Desc    : A fuction that starts the MPD worker thread. Threads do not
+ *           survive fork(), it is called after the daemon is forked.
+ * Inputs  :
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h.
+ * Outputs : 0 on success, -1 on failure. Errors sent to stderr and syslog.
+ */
+int mpd_worker_start(struct items_status *status) {
+   int rc;
+   int request[2];
+   int reply[2];
+   pthread_t thread;
+
+   // Only the request pipe is non blocking for the writer, the worker
+   // waits for the main thread to read its replies.
+   if (pipe(request) < 0 || pipe(reply) < 0 ||
+       fcntl(request[1],F_SETFL,O_NONBLOCK) < 0) {
+      fprintf(stderr, "pipe(): %s\n", strerror(errno));
+      syslog(LOG_ERR,"pipe(): %s", strerror(errno));
+      return -1;
+   }
+
+   status->worker_request = request[0];
+   status->fd_request = request[1];
+   status->fd_reply = reply[0];
+   status->worker_reply = reply[1];
+
+   rc = pthread_create(&thread,NULL,mpd_worker,status);
+   if (rc != 0) {
+      fprintf(stderr, "Can not start MPD thread: %s\n", strerror(rc));
+      syslog(LOG_ERR,"Can not start MPD thread: %s", strerror(rc));
+      return -1;
+   }
+   pthread_detach(thread);
 
+   return 0;
+}
+
+/*
+ * Fuction : mpd_worker
+ * Desc    : The MPD worker thread. It keeps one MPD connection open. While
+ *           there is nothing to do the connection is in MPD "idle" for
+ *           player and mixer changes, also those of other MPD clients. It
+ *           leaves idle to run the requests of process_powermate_event,
+ *           when MPD reports a change and at the polling interval. After
+ *           each of them the MPD status is published and sent to the main
+ *           thread. A failed connection is opened again when a request
+ *           comes in or at the polling interval.
+ * Inputs  : void *arg - The items_status structure.
+ * Outputs : None
+ */
+void *mpd_worker(void *arg) {
+   int i, n, rc;
+   int last_id = 0;
+   int wait = -1;
+   uint64_t now;
+   uint64_t retry = 0;
+   struct items_status *status = arg;
    struct mpd_connection *mpd_conn = NULL;
-   struct mpd_status *mpd_status = NULL;
+   struct worker_request requests[WORKER_REQUESTS];
+   struct pollfd pfds[2];
+
+   for (;; ) {
+
+      now = core_clock_ms();
+      if (mpd_conn == NULL && now >= retry) {
+         mpd_conn = mpd_worker_connect(status,0);
+         if (mpd_conn != NULL) {
+            mpd_conn = mpd_worker_status(status,mpd_conn,0);
+         }
+         retry = now + status->poll * 1000ULL;
+      }
 
-   mpd_conn = mpd_connection_new(status->host, status->port, 30000);
+      pfds[0].fd = status->worker_request;
+      pfds[0].events = POLLIN;
+      pfds[1].fd = mpd_conn != NULL ? mpd_connection_get_fd(mpd_conn) : -1;
+      pfds[1].events = POLLIN;
+      pfds[0].revents = pfds[1].revents = 0;
+
+      wait = status->poll * 1000;
+      if (mpd_conn == NULL) {
+         wait = retry > now ? (int)(retry - now) : 0;
+      }
+
+      rc = poll(pfds,2,wait);
+      if (rc < 0) {
+         if (errno != EINTR) {
+            syslog(LOG_ERR,"MPD thread poll(): %s",strerror(errno));
+         }
+         continue;
+      }
+
+      if (pfds[0].revents & POLLIN) {
+         n = read(status->worker_request,requests,sizeof(requests));
+         n = n > 0 ? n / sizeof(struct worker_request) : 0;
+         if (n == 0) {
+            continue;
+         }
+         last_id = requests[n-1].id;
+
+         // Only process_powermate_event writes the pipe, a request that
+         // does not fit is dropped rather than run.
+         for (i=0; i<n; i++) {
+            if (requests[i].n < 0 || requests[i].n > CORE_MAX_ACTIONS) {
+               syslog(LOG_ERR,"MPD thread: bad request %d",requests[i].id);
+               requests[i].n = 0;
+            }
+         }
+
+         if (mpd_conn == NULL) {
+            mpd_conn = mpd_worker_connect(status,last_id);
+            if (mpd_conn == NULL) {
+               retry = core_clock_ms() + status->poll * 1000ULL;
+               continue;
+            }
+         } else if (!mpd_worker_idle_end(mpd_conn,0)) {
+            // The idle connection broke unnoticed, the requests get a new
+            // one.
+            mpd_connection_free(mpd_conn);
+            mpd_conn = mpd_worker_connect(status,last_id);
+            if (mpd_conn == NULL) {
+               retry = core_clock_ms() + status->poll * 1000ULL;
+               continue;
+            }
+         }
+         rc = MPD_COMMAND_OK;
+         for (i=0; i<n && rc!=MPD_COMMAND_FAILED; i++) {
+            rc = mpd_worker_run(mpd_conn,requests[i].actions,requests[i].n);
+         }
+         mpd_conn = mpd_worker_status(status,mpd_conn,last_id);
+      } else if (mpd_conn != NULL) {
+         // A change or the polling interval.
+         mpd_worker_idle_end(mpd_conn,pfds[1].revents != 0);
+         mpd_conn = mpd_worker_status(status,mpd_conn,0);
+      }
+
+      if (mpd_conn == NULL) {
+         retry = core_clock_ms() + status->poll * 1000ULL;
+      }
+   }
+
+   return NULL;
+}
+
+/*
+ * Fuction : mpd_worker_idle_end
+ * Desc    : A fuction of the worker thread that takes the connection out of
+ *           idle. A failure is recorded in the event journal.
+ * Inputs  :
+ *          struct *mpd_conn - The MPD connection in idle.
+ *          int changed      - 1 when the connection is readable, MPD
+ *                             reported a change, 0 to leave idle without
+ *                             one. MPD may have answered idle already,
+ *                             mpd_run_noidle reads it.
+ * Outputs : 1 when the connection can be used, 0 when it failed.
+ */
+int mpd_worker_idle_end(struct mpd_connection *mpd_conn, int changed) {
+
+   if (changed) {
+      mpd_recv_idle(mpd_conn,false);
+   } else {
+      mpd_run_noidle(mpd_conn);
+   }
 
    if (mpd_connection_get_error(mpd_conn) != MPD_ERROR_SUCCESS) {
-      mpd_error = mpd_connection_get_error_message(mpd_conn);
-      fprintf(stderr, "Error: mpd connection: %s\n", mpd_error);
-      syslog(LOG_ERR,"Error: mpd connection: %s", mpd_error);
-      if (debug) { fprintf(stderr,"%s\n",mpd_error); }
+      journal_write(JOURNAL_MPD,0,JOURNAL_MPD_IDLE,0,
+                    mpd_connection_get_error(mpd_conn));
+      return 0;
+   }
+
+   return 1;
+}
+
+/*
+ * Fuction : mpd_worker_connect
+ * Desc    : A fuction of the worker thread that connects to MPD. A failure
+ *           is sent to the main thread.
+ * Inputs  :
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h.
+ *          int id           - The last request the connection is for, 0
+ *                             for none.
+ * Outputs : The MPD connection, NULL on failure.
+ */
+struct mpd_connection *mpd_worker_connect(struct items_status *status,
+                                          int id) {
+   struct mpd_connection *mpd_conn = NULL;
+   struct worker_reply reply;
+
+   mpd_conn = mpd_connect(status);
+
+   if (mpd_conn == NULL) {
+      reply.id = id;
+      reply.mpd_state = -1;
+      write(status->worker_reply,&reply,sizeof(reply));
+   }
+
+   return mpd_conn;
+}
+
+/*
+ * Fuction : mpd_worker_status
+ * Desc    : A fuction of the worker thread that reads the MPD status,
+ *           publishes it and sends it to the main thread. The connection is
+ *           then put into idle. A failed connection is freed.
+ * Inputs  :
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h.
+ *          struct *mpd_conn - The MPD connection, not in idle.
+ *          int id           - The last request that was run, 0 for none.
+ * Outputs : The connection in idle, NULL when it failed.
+ */
+struct mpd_connection *mpd_worker_status(struct items_status *status,
+                                         struct mpd_connection *mpd_conn,
+                                         int id) {
+   struct mpd_status *mpd_status = NULL;
+   struct worker_reply reply;
+
+   // The failed idle or command is already in the journal.
+   if (mpd_connection_get_error(mpd_conn) == MPD_ERROR_SUCCESS) {
+      mpd_status = mpd_query_status(mpd_conn);
+   } else {
+      state_publish_failure();
+   }
+
+   reply.id = id;
+   reply.mpd_state = -1;
+
+   if (mpd_status != NULL) {
+      reply.mpd_state = mpd_status_get_state(mpd_status);
+      mpd_status_free(mpd_status);
+   }
+
+   if (reply.mpd_state < 0 ||
+       !mpd_send_idle_mask(mpd_conn,MPD_IDLE_PLAYER | MPD_IDLE_MIXER)) {
+      if (debug) { fprintf(stderr,"mpd connection: %s\n",
+                           mpd_connection_get_error_message(mpd_conn)); }
+      reply.mpd_state = -1;
       mpd_connection_free(mpd_conn);
-      return;
+      mpd_conn = NULL;
+   }
+
+   write(status->worker_reply,&reply,sizeof(reply));
+
+   return mpd_conn;
+}
+
+/*
+ * Fuction : mpd_worker_run
+ * Desc    : A fuction of the worker thread that sends the MPD commands of
+ *           one request. A rejected command leaves the connection usable,
+ *           the status read after the request shows whether MPD is in the
+ *           state the LED shows.
+ * Inputs  :
+ *          struct *mpd_conn - The MPD connection, not in idle.
+ *          struct *actions  - The actions of the request.
+ *          int n            - The number of actions.
+ * Outputs : The mpd_command_result of the last command.
+ */
+int mpd_worker_run(struct mpd_connection *mpd_conn,
+                   const struct core_action *actions, int n) {
+   int i = -1;
+   int rc = MPD_COMMAND_OK;
+
+   for (i=0; i<n && rc!=MPD_COMMAND_FAILED; i++) {
+      switch (actions[i].type) {
+      case CORE_ACTION_VOLUME:
+         if (debug) {printf("  -Volume Change %d\n",actions[i].value); }
+         mpd_send_change_volume(mpd_conn,actions[i].value);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_VOLUME,
+                                 actions[i].value);
+         break;
+      case CORE_ACTION_NEXT:
+         if (debug) {printf("   -Next: in play list\n"); }
+         mpd_send_next(mpd_conn);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_NEXT,0);
+         break;
+      case CORE_ACTION_PREVIOUS:
+         if (debug) {printf("   -Previous: in play list\n"); }
+         mpd_send_previous(mpd_conn);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_PREVIOUS,0);
+         break;
+      case CORE_ACTION_TOGGLE_PAUSE:
+         if (debug) { printf(" -Button Down %s\n  -Pause\n",
+                             actions[i].value ? "Long" : "Short (tap)"); }
+         mpd_send_toggle_pause(mpd_conn);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_TOGGLE_PAUSE,0);
+         break;
+      case CORE_ACTION_PLAY:
+         if (debug) { printf(" -Button Down Long\n  -Play\n"); }
+         mpd_send_play(mpd_conn);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_PLAY,0);
+         break;
+      case CORE_ACTION_STOP:
+         if (debug) { printf(" -Button Down Long\n  -Stop\n"); }
+         mpd_send_stop(mpd_conn);
+         rc = mpd_command_result(mpd_conn,JOURNAL_MPD_STOP,0);
+         break;
+      case CORE_ACTION_LONG_PRESS:
+         if (debug) { printf(" -Button Down Long\n"); }
+         rc = powermate_long_press(mpd_conn);
+         break;
+      }
+   }
+   if (debug) { fflush(stdout); }
+
+   return rc;
+}
+
+/*
+ * Fuction : mpd_worker_reply
+ * Desc    : A fuction that reads the replies of the MPD worker thread and
+ *           confirms or corrects the LED with them. A reported state is
+ *           skipped while a newer request is pending, the reply to that
+ *           request confirms the LED.
+ * Inputs  :
+ *          int fd           - The powermate file descriptor.
+ *          struct *status   - A items_status structure that is defined in
+ *                             local powermate.h.
+ * Outputs : None
+ */
+void mpd_worker_reply(int fd, struct items_status *status) {
+   int i, n, rc;
+
+   struct worker_reply replies[WORKER_REQUESTS];
+   struct core_action actions[CORE_MAX_ACTIONS];
+
+   rc = read(status->fd_reply,replies,sizeof(replies));
+   rc = rc > 0 ? rc / sizeof(struct worker_reply) : 0;
+
+   for (i=0; i<rc; i++) {
+      if (replies[i].id != 0) {
+         status->reply_id = replies[i].id;
+      }
+
+      if (replies[i].mpd_state < 0) {
+         n = core_fail(&status->core,actions);
+      } else if (status->reply_id == status->request_id) {
+         n = core_confirm(&status->core,replies[i].mpd_state,core_clock_ms(),
+                          actions);
+      } else {
+         n = 0;
+      }
+      powermate_led_actions(fd,actions,n);
+   }
+   if (debug) { fflush(stdout); }
+}
+
+/*
+ * Fuction : powermate_led_actions
+ * Desc    : A fuction that carries out the LED actions of the event core.
+ * Inputs  :
+ *          int fd           - The powermate file descriptor.
+ *          struct *actions  - The actions, other than LED actions are
+ *                             skipped.
+ *          int n            - The number of actions.
+ * Outputs : None
+ */
+void powermate_led_actions(int fd, struct core_action *actions, int n) {
+   int i;
+
+   for (i=0; i<n; i++) {
+      if (actions[i].type != CORE_ACTION_LED) {
+         continue;
+      }
+      if (debug) {
+         switch (actions[i].value) {
+         case CORE_LED_OFF:
+            printf("  -LED: Stop\n");
+            break;
+         case CORE_LED_ON:
+            printf("  -LED: Play\n");
+            break;
+         case CORE_LED_PAUSE:
+            printf("  -LED: Pause\n");
+            break;
+         case CORE_LED_ALERT:
+            printf("  -LED: Alert\n");
+            break;
+         }
+      }
+      powermate_led(fd,actions[i].value);
    }
+}
+
+/*
+ * Fuction : powermate_long_press
+ * Desc    : A fuction that starts or stops the MPD playback for a long
+ *           button press when the MPD state was not known. Paused playback
+ *           is un-paused.
+ * Inputs  : struct *mpd_conn - A connected MPD connection.
+ * Outputs : The mpd_command_result of the command, MPD_COMMAND_FAILED when
+ *           the MPD status could not be read.
+ */
+int powermate_long_press(struct mpd_connection *mpd_conn) {
+   int rc = MPD_COMMAND_OK;
 
-   mpd_send_status(mpd_conn);
-   mpd_status = mpd_recv_status(mpd_conn);
+   struct mpd_status *mpd_status = NULL;
+
+   mpd_status = mpd_query_status(mpd_conn);
+   if (mpd_status == NULL) {
+      return MPD_COMMAND_FAILED;
+   }
 
    switch (mpd_status_get_state(mpd_status)) {
    case MPD_STATE_STOP:
-      if (debug) { printf(" LED: Stop\n"); }
-      powermate_led(fd,0);
+      if (debug) { printf("  -Play\n"); }
+      mpd_send_play(mpd_conn);
+      rc = mpd_command_result(mpd_conn,JOURNAL_MPD_PLAY,0);
       break;
    case MPD_STATE_PLAY:
-      if (debug) { printf(" LED: Play\n"); }
-      status->mpd_paused = 0;
-      powermate_led(fd,1);
+      if (debug) { printf("  -Stop\n"); }
+      mpd_send_stop(mpd_conn);
+      rc = mpd_command_result(mpd_conn,JOURNAL_MPD_STOP,0);
       break;
    case MPD_STATE_PAUSE:
-      if (debug) { printf(" LED: Pause\n"); }
-      status->mpd_paused = 1;
-      powermate_led(fd,3);
+      if (debug) { printf("  -Pause\n"); }
+      mpd_send_toggle_pause(mpd_conn);
+      rc = mpd_command_result(mpd_conn,JOURNAL_MPD_TOGGLE_PAUSE,0);
       break;
    case MPD_STATE_UNKNOWN:
-      if (debug) { printf(" LED: UNKNOWN\n"); }
+      if (debug) { printf("  -UNKNOWN\n"); }
       break;
    }
 
-   mpd_connection_free(mpd_conn);
+   mpd_status_free(mpd_status);
+
+   return rc;
 }
 
 /*
- * Fuction : process_powermate_event
- * Desc    : A fuction that takes some action when the state of the powermate
- *           changes.
- * Inputs  :
- *          int fd           - The powermate file descriptor.
- *          struct *ev       - A input_event structure. The structure is defined
- *                             in linux/input.h.
- *          struct *status   - A items_status structure that is defined in
- *                             local powermate.h.
- * Outputs : Errors sent to stderr and syslog.
+ * Fuction : mpd_query_status
+ * Desc    : A fuction that asks MPD for its status. The status is recorded in
+ *           the event journal and published in the state file.
+ * Inputs  : struct *mpd_conn - A connected MPD connection.
+ * Outputs : The MPD status that the caller frees, NULL on failure.
  */
-void process_powermate_event(int fd, struct input_event *ev,
-                             struct items_status *status) {
+struct mpd_status *mpd_query_status(struct mpd_connection *mpd_conn) {
+   struct mpd_status *mpd_status = NULL;
 
-   const char *mpd_error;
+   mpd_status = mpd_run_status(mpd_conn);
 
-   struct mpd_connection *mpd_conn = NULL;
-   struct mpd_status *mpd_status = NULL;
+   if (mpd_status == NULL) {
+      journal_write(JOURNAL_MPD,0,JOURNAL_MPD_STATUS,0,
+                    mpd_connection_get_error(mpd_conn));
+      state_publish_failure();
+      return NULL;
+   }
 
-   time_t up_time;
+   journal_write(JOURNAL_MPD,0,JOURNAL_MPD_STATUS,
+                 mpd_status_get_state(mpd_status),MPD_ERROR_SUCCESS);
+   state_publish(mpd_status_get_state(mpd_status),
+                 mpd_status_get_volume(mpd_status),
+                 mpd_status_get_song_id(mpd_status),
+                 mpd_status_get_elapsed_ms(mpd_status));
 
-   mpd_conn = mpd_connection_new(status->host, status->port, 30000);
+   return mpd_status;
+}
 
-   if (mpd_connection_get_error(mpd_conn) != MPD_ERROR_SUCCESS) {
-      mpd_error = mpd_connection_get_error_message(mpd_conn);
-      fprintf(stderr, "Error: mpd connection: %s\n", mpd_error);
-      syslog(LOG_ERR,"Error: mpd connection: %s", mpd_error);
-      if (debug) { fprintf(stderr,"%s\n",mpd_error); }
-      mpd_connection_free(mpd_conn);
-      return;
+/*
+ * Fuction : mpd_command_result
+ * Desc    : A fuction that reads the response of a MPD command and records
+ *           the command and its result in the event journal. When MPD
+ *           rejects the command (e.g. "volume" without a mixer) the error
+ *           is cleared, libmpdclient refuses every later call on the
+ *           connection until it is.
+ * Inputs  :
+ *          struct *mpd_conn - The MPD connection the command was sent on.
+ *          int command      - The JOURNAL_MPD command that was sent.
+ *          int value        - The command argument.
+ * Outputs : MPD_COMMAND_OK when MPD accepted the command,
+ *           MPD_COMMAND_REJECTED when MPD rejected it and the connection can
+ *           still be used, MPD_COMMAND_FAILED when the connection failed.
+ *           Errors sent to stderr when in debug mode.
+ */
+int mpd_command_result(struct mpd_connection *mpd_conn, int command,
+                       int value) {
+   enum mpd_error result = MPD_ERROR_SUCCESS;
+
+   if (mpd_response_finish(mpd_conn)) {
+      journal_write(JOURNAL_MPD,0,command,value,result);
+      return MPD_COMMAND_OK;
    }
 
-   switch (ev->type) {
-   case EV_REL:
-      if (ev->code == REL_DIAL) {
+   result = mpd_connection_get_error(mpd_conn);
+   if (debug) { fprintf(stderr,"mpd command: %s\n",
+                        mpd_connection_get_error_message(mpd_conn)); }
 
-         if (debug) {
-            printf(" -Button %s %d: was rotated %d units.\n",
-                   status->powermate_button ? "down" : "up",
-                   status->powermate_button,
-                   (int)ev->value);
-         }
+   journal_write(JOURNAL_MPD,0,command,value,result);
 
-         if (status->powermate_button == 1 ) {
-
-            // Rotation is too sensitive.
-            // Change Item in play list for every other rotation.
-            // Bitwise OR of random varies between two values (-1,0)
-            status->random = ~status->random;
-            if (debug) {printf("  -Random: %d\n",status->random); }
-            if (status->random == 0) {
-
-               status->down_rot = 1;
-               if ((int)ev->value > 0) {
-                  if (debug) {printf("   -Next: in play list\n"); }
-                  mpd_send_next(mpd_conn);
-               } else if ((int)ev->value < 0) {
-                  if (debug) {printf("   -Previous: in play list\n"); }
-                  mpd_send_previous(mpd_conn);
-               }
-            }
-         } else {
-            if (debug) {printf("  -Volume Change %d\n",(int)ev->value); }
-            mpd_send_change_volume(mpd_conn,(int)ev->value);
-         }
+   if (result == MPD_ERROR_SERVER && mpd_connection_clear_error(mpd_conn)) {
+      return MPD_COMMAND_REJECTED;
+   }
+
+   return MPD_COMMAND_FAILED;
+}
 
+/*
+ * Fuction : replay_print
+ * Desc    : A fuction that prints the actions of the event core for one
+ *           replayed record.
+ * Inputs  :
+ *          uint64_t now     - The recorded time in core clock ms.
+ *          struct *actions  - The actions.
+ *          int n            - The number of actions.
+ * Outputs : One line per action sent to stdout.
+ */
+void replay_print(uint64_t now, const struct core_action *actions, int n) {
+   int i = -1;
+
+   for (i=0; i<n; i++) {
+      printf("%6llu.%03llu ",(unsigned long long)(now / 1000),
+             (unsigned long long)(now % 1000));
+      switch (actions[i].type) {
+      case CORE_ACTION_BUTTON:
+         printf("button %s\n",actions[i].value ? "down" : "up");
+         break;
+      case CORE_ACTION_VOLUME:
+         printf("volume %d\n",actions[i].value);
+         break;
+      case CORE_ACTION_NEXT:
+         printf("next\n");
+         break;
+      case CORE_ACTION_PREVIOUS:
+         printf("previous\n");
+         break;
+      case CORE_ACTION_TOGGLE_PAUSE:
+         printf("toggle-pause%s\n",actions[i].value ? " (long press)" : "");
+         break;
+      case CORE_ACTION_LONG_PRESS:
+         printf("long-press\n");
+         break;
+      case CORE_ACTION_PLAY:
+         printf("play\n");
+         break;
+      case CORE_ACTION_STOP:
+         printf("stop\n");
+         break;
+      case CORE_ACTION_LED:
+         printf("led %s\n",actions[i].value == CORE_LED_OFF ? "off" :
+                actions[i].value == CORE_LED_PAUSE ? "pause" :
+                actions[i].value == CORE_LED_ALERT ? "alert" : "on");
+         break;
+      default:
+         printf("action %d %d\n",actions[i].type,actions[i].value);
+         break;
       }
-      break;
+   }
+}
 
-   case EV_KEY:
-      if (ev->code == BTN_0) {
-         switch (ev->value) {
-         case 0:
-            if (debug) { printf("Button UP\n"); }
-            status->powermate_button = 0;
-            if (status->down_rot == 1) {
-               status->down_rot = 0;
-               break;
-            }
+/*
+ * Fuction : replay_journal
+ * Desc    : A fuction that feeds the input events recorded in a journal file
+ *           through the event core with their recorded time stamps and
+ *           prints the actions it takes. The recorded MPD status reads and
+ *           failures confirm or fail the LED as MPD did. MPD and the
+ *           powermate are not used and the replay does not wait.
+ * Inputs  :
+ *          char *path       - The journal file.
+ *          struct *core     - The event processing state.
+ * Outputs : EXIT_SUCCESS or EXIT_FAILURE. Errors sent to stderr.
+ */
+int replay_journal(const char *path, struct powermate_core *core) {
+   int n = 0;
+   int64_t wait = -1;
+   uint64_t i, count, head, now;
+   size_t length;
+
+   struct journal_header *header;
+   const struct journal_record *rec;
+   struct input_event ev;
+   struct core_action actions[CORE_MAX_ACTIONS];
 
-            up_time = time(0);
-
-            if ( difftime(up_time,status->down_time) > 1 && ev->code
-                 != REL_DIAL ) {
-               if (debug) { printf(" -Button Down Long\n"); }
-               mpd_send_status(mpd_conn);
-               mpd_status = mpd_recv_status(mpd_conn);
-               switch (mpd_status_get_state(mpd_status)) {
-               case MPD_STATE_STOP:
-                  if (debug) { printf("  -Play\n"); }
-                  mpd_send_play(mpd_conn);
-                  powermate_led(fd,1);
-                  break;
-               case MPD_STATE_PLAY:
-                  if (debug) { printf("  -Stop\n"); }
-                  mpd_send_stop(mpd_conn);
-                  powermate_led(fd,0);
-                  break;
-               case MPD_STATE_PAUSE:
-                  if (debug) { printf("  -Pause\n"); }
-                  mpd_send_toggle_pause(mpd_conn);
-                  break;
-               case MPD_STATE_UNKNOWN:
-                  if (debug) { printf("  -UNKNOWN\n"); }
-                  break;
-               }
-
-            } else {
-               if (debug) { printf(" -Button Down Short (tap)\n"); }
-               mpd_send_toggle_pause(mpd_conn);
-               switch (status->mpd_paused) {
-               case 0:
-                  printf("  -LED: Paused\n");
-                  status->mpd_paused = 1;
-                  powermate_led(fd,3);
-                  break;
-               case 1:
-                  printf("  -LED: Un-Paused\n");
-                  status->mpd_paused = 0;
-                  powermate_led(fd,2);
-                  break;
-               }
-            }
-            break;
-         case 1:
-            if (debug) { printf("Button Down\n"); }
-            status->powermate_button = 1;
-            status->down_time = time(0);
-            break;
-         }
+   header = journal_map(path,&length);
+   if (header == NULL) {
+      fprintf(stderr, "Can not read journal %s: %s\n", path, strerror(errno));
+      return EXIT_FAILURE;
+   }
 
+   memset(&ev, 0, sizeof(struct input_event));
+   count = journal_count(header,&head);
+   now = 0;
+
+   for (i=0; i<=count; i++) {
+      rec = i < count ? journal_get(header,head,i) : NULL;
+
+      // End a LED mismatch pattern that ran out before this record.
+      wait = core_timeout(core,now);
+      if (wait >= 0 && (rec == NULL || now + wait <= rec->time_ns / 1000000 ||
+                        rec->kind == JOURNAL_START)) {
+         n = core_tick(core,now + wait,actions);
+         replay_print(now + wait,actions,n);
+      }
+      if (rec == NULL) {
+         break;
       }
 
+      now = rec->time_ns / 1000000;
+      n = 0;
+
+      switch (rec->kind) {
+      case JOURNAL_START:
+         // A new run of the daemon, its MPD state is not known yet.
+         printf("%6llu.%03llu start pid=%d\n",(unsigned long long)(now / 1000),
+                (unsigned long long)(now % 1000),rec->value);
+         core_init(core);
+         break;
+      case JOURNAL_INPUT:
+         ev.type = rec->type;
+         ev.code = rec->code;
+         ev.value = rec->value;
+         n = core_process_event(core,&ev,now,actions);
+         break;
+      case JOURNAL_MPD:
+         if (rec->code == JOURNAL_MPD_STATUS &&
+             rec->result == MPD_ERROR_SUCCESS) {
+            n = core_confirm(core,rec->value,now,actions);
+         } else if (rec->result != MPD_ERROR_SUCCESS &&
+                    (rec->code == JOURNAL_MPD_STATUS ||
+                     rec->result != MPD_ERROR_SERVER)) {
+            // A failed connection, MPD rejecting a command leaves it
+            // usable.
+            n = core_fail(core,actions);
+         }
+         break;
+      }
+      replay_print(now,actions,n);
    }
-   if (debug) { fflush(stdout); }
 
-   mpd_connection_free(mpd_conn);
+   journal_unmap(header,length);
+
+   return EXIT_SUCCESS;
 }
 
 /*
@@ -537,6 +1306,11 @@ void powermate_led(int fd, int state) {
       pulse_speed = 260;
       pulse_awake = 1;
       break;
+   case 4:
+      // Alert, MPD did not do what the LED showed or MPD failed
+      pulse_speed = 450;
+      pulse_awake = 1;
+      break;
    }
 
    static_brightness &= 0xFF;
@@ -557,6 +1331,8 @@ void powermate_led(int fd, int state) {
    ev.value = static_brightness | (pulse_speed << 8) | (pulse_table << 17)
               | (pulse_asleep << 19) | (pulse_awake << 20);
 
+   journal_write(JOURNAL_LED,0,0,state,0);
+
    if (write(fd,&ev,sizeof(struct input_event)) != sizeof(struct input_event)) {
       fprintf(stderr, "write(): %s\n", strerror(errno));
       syslog(LOG_ERR,"write(): %s\n", strerror(errno));
@@ -597,32 +1373,49 @@ int AsciiDecCharToInt (char localLine[50], int start,int length) {
 /*
  * Fuction : signal_handler
  * Desc    : The signal handler fuction that is registered with system kernel
- *           via a sigaction structure.
+ *           via a sigaction structure. It only records the signal, the main
+ *           thread clears the state file and exits after
+ *           monitor_powermate_mpd returns.
  * Inputs  : int signal - The system signal sent to the running process.
- * Outputs : Process termination value.
+ * Outputs : None
  */
 void signal_handler(int signal) {
 
    switch (signal) {
    case SIGTERM:
-      syslog(LOG_NOTICE,"Received SIGTERM: Exiting");
-      unlink(LOCKFILE);
-      exit(EXIT_SUCCESS);
-      break;
    case SIGINT:
-      syslog(LOG_NOTICE,"Received SIGINT: Exiting");
-      unlink(LOCKFILE);
-      exit(EXIT_SUCCESS);
-      break;
-   case SIGKILL:
-      syslog(LOG_NOTICE,"Received SIGKILL: Exiting");
-      unlink(LOCKFILE);
-      exit(EXIT_SUCCESS);
+      exit_signal = signal;
       break;
    }
 
 }
 
+/*
+ * Fuction : set_signal_handler
+ * Desc    : A fuction that registers signal_handler with the system kernel.
+ *           SIGTERM and SIGINT are blocked, monitor_powermate_mpd lets them
+ *           through while it waits. Threads started later inherit the
+ *           blocked signals, so the handler never interrupts them.
+ * Inputs  : None
+ * Outputs : None
+ */
+void set_signal_handler() {
+   struct sigaction sa;
+   sigset_t sigmask;
+
+   // Clear the signal mask so that no new TTYs will be opened.
+   sa.sa_handler = signal_handler;
+   sigemptyset(&sa.sa_mask);
+   sa.sa_flags = 0;
+   sigaction(SIGTERM,&sa,NULL);
+   sigaction(SIGINT,&sa,NULL);
+
+   sigemptyset(&sigmask);
+   sigaddset(&sigmask,SIGTERM);
+   sigaddset(&sigmask,SIGINT);
+   sigprocmask(SIG_BLOCK,&sigmask,NULL);
+}
+
 /*
  * Fuction : daemonize
  * Desc    : A fuction the daemonizes the process.
@@ -631,12 +1424,12 @@ void signal_handler(int signal) {
  */
 void daemonize() {
    int lf_fd;
+   int null_fd;
    char buf[16];
    pid_t pid, sid;
 
    struct flock lf_flock;
    struct rlimit rl;
-   struct sigaction sa;
 
    // Change the file mode mask
    umask(0);
@@ -675,13 +1468,7 @@ void daemonize() {
    }
 
    // Setup signal handler with system kernel.
-   // Clear the signal mask so that no new TTYs will be opened.
-   sa.sa_handler = signal_handler;
-   sigemptyset(&sa.sa_mask);
-   sa.sa_flags = 0;
-   sigaction(SIGTERM,&sa,NULL);
-   sigaction(SIGINT,&sa,NULL);
-   sigaction(SIGKILL,&sa,NULL);
+   set_signal_handler();
 
    // Create lock / pid file.
    lf_fd = open(LOCKFILE, O_RDWR | O_CREAT,
@@ -713,10 +1500,20 @@ void daemonize() {
    sprintf(buf,"%ld", (long)getpid());
    write(lf_fd,buf,strlen(buf)+1);
 
-   // Close out the standard file descriptors
-   close(STDIN_FILENO);
-   close(STDOUT_FILENO);
-   close(STDERR_FILENO);
+   // Point the standard file descriptors at /dev/null. Closing them would
+   // let the syslog socket or the MPD thread pipes take fd 0 to 2, and
+   // every message for stderr would go into them.
+   null_fd = open("/dev/null", O_RDWR);
+   if (null_fd < 0) {
+      syslog(LOG_ERR,"Can not open /dev/null: %s",strerror(errno));
+      exit(EXIT_FAILURE);
+   }
+   dup2(null_fd,STDIN_FILENO);
+   dup2(null_fd,STDOUT_FILENO);
+   dup2(null_fd,STDERR_FILENO);
+   if (null_fd > STDERR_FILENO) {
+      close(null_fd);
+   }
 
    syslog(LOG_NOTICE,"Start Up");
 
@@ -33,16 +33,49 @@
 #define MSC_PULSELED 0x01
 #endif
 
+#define MPD_SOCKET "/run/mpd/socket"
+#define MPD_DEFAULT_HOST "::1"
+#define MPD_DEFAULT_PORT 6600
+
+// A Unix socket path or a Linux abstract socket name.
+#define MPD_HOST_IS_SOCKET(host) ((host)[0] == '/' || (host)[0] == '@')
+
 #define LOCKFILE "/usr/local/var/run/powermate-mpd.pid"
 
+// mpd_command_result values
+#define MPD_COMMAND_OK        1
+#define MPD_COMMAND_REJECTED  0 // MPD refused, the connection is still usable
+#define MPD_COMMAND_FAILED   -1 // The connection failed
+
+// Most requests or replies read from a worker pipe at once.
+#define WORKER_REQUESTS 16
+
+// MPD commands process_powermate_event hands to the MPD worker thread.
+struct worker_request {
+   int id;                                      // Increases by one
+   int n;
+   struct core_action actions[CORE_MAX_ACTIONS];
+};
+
+// A MPD state the worker thread read, after the request "id" or when MPD
+// reported a change (id 0).
+struct worker_reply {
+   int id;
+   int mpd_state; // libmpdclient "enum mpd_state", -1 when MPD failed
+};
+
 struct items_status {
-   char host[46];
+   char *host;     // Host name, IP address or Unix socket path
+   char *password; // NULL when MPD needs no password
    int port;
-   int powermate_button;
-   int down_rot;
-   int mpd_paused;
-   int random;
-   time_t down_time;
+   int poll;           // Polling interval in seconds
+   int fd_request;     // Main thread end of the request pipe
+   int fd_reply;       // Main thread end of the reply pipe
+   int worker_request; // Worker thread end of the request pipe
+   int worker_reply;   // Worker thread end of the reply pipe
+   int request_id;     // Last request sent to the worker thread
+   int reply_id;       // Last request the worker thread answered
+   struct powermate_core core;
 } * items_status;
 
 static const char *valid_prefix[NUM_VALID_PREFIXES] = {
@@ -50,14 +83,33 @@ static const char *valid_prefix[NUM_VALID_PREFIXES] = {
   "Griffin SoundKnob"
 };
 
-void monitor_powermate_mpd(int fd_powermate,int poll,
-                           struct items_status *status);
-void powermate_led_state(int fd_powermate,struct items_status *status);
+void mpd_host_settings(struct items_status *status, const char *host);
+struct mpd_connection *mpd_connect(struct items_status *status);
+void monitor_powermate_mpd(int fd_powermate,struct items_status *status);
 void process_powermate_event(int fd, struct input_event *ev,
                              struct items_status *status);
+int mpd_worker_start(struct items_status *status);
+void *mpd_worker(void *arg);
+int mpd_worker_idle_end(struct mpd_connection *mpd_conn, int changed);
+struct mpd_connection *mpd_worker_connect(struct items_status *status,
+                                          int id);
+struct mpd_connection *mpd_worker_status(struct items_status *status,
+                                         struct mpd_connection *mpd_conn,
+                                         int id);
+int mpd_worker_run(struct mpd_connection *mpd_conn,
+                   const struct core_action *actions, int n);
+void mpd_worker_reply(int fd, struct items_status *status);
+void powermate_led_actions(int fd, struct core_action *actions, int n);
+int powermate_long_press(struct mpd_connection *mpd_conn);
+struct mpd_status *mpd_query_status(struct mpd_connection *mpd_conn);
+int mpd_command_result(struct mpd_connection *mpd_conn, int command,
+                       int value);
+void replay_print(uint64_t now, const struct core_action *actions, int n);
+int replay_journal(const char *path, struct powermate_core *core);
 int find_powermate(int mode);
 int open_powermate(const char *dev, int mode);
 void powermate_led(int fd, int state);
 int AsciiDecCharToInt (char localLine[50], int start,int length);
 void signal_handler(int signal);
+void set_signal_handler();
 void daemonize();
@@ -0,0 +1,591 @@
+/* powermate-net.c
+ * MPD host name resolution and connection for Powermate-mpd.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <resolv.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/nameser.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "./powermate-net.h"
+
+// The resolved addresses of the MPD host. The background thread refreshes
+// them when they expire, net_lookup never waits for it.
+static struct {
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   char *host;
+   char port[8];
+   struct net_addr addrs[NET_MAX_ADDRS];
+   int count;
+   uint64_t expires;   // net_clock_ms, 0 for an IP address
+   int refresh;
+   int running;
+   struct net_addr preferred;
+   int has_preferred;
+} cache = {
+   .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * Fuction : net_clock_ms
+ * Desc    : The clock of the address cache.
+ * Inputs  : None
+ * Outputs : CLOCK_MONOTONIC in milliseconds.
+ */
+static uint64_t net_clock_ms(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Fuction : net_dns_ttl
+ * Desc    : A fuction that asks DNS for the lowest TTL of the answers for a
+ *           host name. getaddrinfo does not return the TTL.
+ * Inputs  :
+ *           res_state res - Resolver state of the calling thread.
+ *           char *host    - The host name.
+ *           int type      - ns_t_a or ns_t_aaaa.
+ * Outputs : The TTL in seconds, -1 when DNS has no answer.
+ */
+static long net_dns_ttl(res_state res, const char *host, int type) {
+   unsigned char answer[NS_PACKETSZ * 4];
+   long ttl = -1;
+   int i, len;
+   ns_msg msg;
+   ns_rr rr;
+
+   len = res_nsearch(res,host,ns_c_in,type,answer,sizeof(answer));
+   if (len < 0 || ns_initparse(answer,len,&msg) < 0) {
+      return -1;
+   }
+
+   for (i=0; i<ns_msg_count(msg,ns_s_an); i++) {
+      if (ns_parserr(&msg,ns_s_an,i,&rr) < 0) {
+         break;
+      }
+      if (ttl < 0 || (long)ns_rr_ttl(rr) < ttl) {
+         ttl = ns_rr_ttl(rr);
+      }
+   }
+
+   return ttl;
+}
+
+/*
+ * Fuction : net_resolve
+ * Desc    : A fuction that resolves the MPD host. It blocks and is called by
+ *           net_init and the background thread only.
+ * Inputs  :
+ *           struct *addrs  - Array of NET_MAX_ADDRS addresses.
+ *           uint64_t *ttl  - Set to the cache lifetime in ms, 0 for an IP
+ *                            address that never expires.
+ * Outputs : The number of addresses, -1 on failure.
+ */
+static int net_resolve(struct net_addr *addrs, uint64_t *ttl) {
+   int n = 0;
+   int rc;
+   long ttl_a, ttl_aaaa;
+
+   struct addrinfo hints;
+   struct addrinfo *result, *ai;
+   struct __res_state res;
+
+   memset(&hints,0,sizeof(hints));
+   hints.ai_family = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_flags = AI_ADDRCONFIG;
+
+   rc = getaddrinfo(cache.host,cache.port,&hints,&result);
+   if (rc != 0) {
+      syslog(LOG_WARNING,"Can not resolve %s: %s",cache.host,gai_strerror(rc));
+      return -1;
+   }
+
+   for (ai=result; ai!=NULL && n<NET_MAX_ADDRS; ai=ai->ai_next) {
+      memcpy(&addrs[n].sa,ai->ai_addr,ai->ai_addrlen);
+      addrs[n].len = ai->ai_addrlen;
+      n++;
+   }
+   freeaddrinfo(result);
+
+   // IP addresses do not expire.
+   hints.ai_flags = AI_NUMERICHOST;
+   if (getaddrinfo(cache.host,NULL,&hints,&result) == 0) {
+      freeaddrinfo(result);
+      *ttl = 0;
+      return n;
+   }
+
+   *ttl = NET_DEFAULT_TTL_MS;
+   memset(&res,0,sizeof(res));
+   if (res_ninit(&res) == 0) {
+      ttl_a = net_dns_ttl(&res,cache.host,ns_t_a);
+      ttl_aaaa = net_dns_ttl(&res,cache.host,ns_t_aaaa);
+      if (ttl_a < 0 || (ttl_aaaa >= 0 && ttl_aaaa < ttl_a)) {
+         ttl_a = ttl_aaaa;
+      }
+      if (ttl_a >= 0) {
+         *ttl = (uint64_t)ttl_a * 1000;
+      }
+      res_nclose(&res);
+   }
+
+   if (*ttl < NET_MIN_TTL_MS) {
+      *ttl = NET_MIN_TTL_MS;
+   }
+   if (*ttl > NET_MAX_TTL_MS) {
+      *ttl = NET_MAX_TTL_MS;
+   }
+
+   return n;
+}
+
+/*
+ * Fuction : net_store
+ * Desc    : A fuction that stores a resolution in the cache. The caller
+ *           holds the cache lock. A failed resolution keeps the old
+ *           addresses and is retried after NET_RETRY_MS.
+ * Inputs  :
+ *           struct *addrs - The resolved addresses.
+ *           int n         - The number of addresses, -1 on failure.
+ *           uint64_t ttl  - The cache lifetime in ms, 0 for never.
+ * Outputs : None
+ */
+static void net_store(const struct net_addr *addrs, int n, uint64_t ttl) {
+
+   if (n <= 0) {
+      cache.expires = net_clock_ms() + NET_RETRY_MS;
+      return;
+   }
+
+   memcpy(cache.addrs,addrs,n * sizeof(struct net_addr));
+   cache.count = n;
+   cache.expires = ttl ? net_clock_ms() + ttl : 0;
+}
+
+/*
+ * Fuction : net_thread
+ * Desc    : The background resolver. It refreshes the cache when it expires
+ *           or when net_lookup found it empty.
+ * Inputs  : void *arg - Not used.
+ * Outputs : None
+ */
+static void *net_thread(void *arg) {
+   int n;
+   uint64_t ttl;
+   struct timespec ts;
+   struct net_addr addrs[NET_MAX_ADDRS];
+
+   (void)arg;
+
+   pthread_mutex_lock(&cache.lock);
+   for (;;) {
+      while (!cache.refresh) {
+         if (cache.expires == 0 && cache.count > 0) {
+            pthread_cond_wait(&cache.cond,&cache.lock);
+            continue;
+         }
+         if (net_clock_ms() >= cache.expires) {
+            break;
+         }
+         ts.tv_sec = cache.expires / 1000;
+         ts.tv_nsec = (cache.expires % 1000) * 1000000;
+         pthread_cond_timedwait(&cache.cond,&cache.lock,&ts);
+      }
+      cache.refresh = 0;
+      pthread_mutex_unlock(&cache.lock);
+
+      n = net_resolve(addrs,&ttl);
+
+      pthread_mutex_lock(&cache.lock);
+      net_store(addrs,n,ttl);
+   }
+
+   return NULL;
+}
+
+/*
+ * Fuction : net_init
+ * Desc    : A fuction that sets the MPD host and resolves it. It blocks, the
+ *           daemon calls it once when it starts.
+ * Inputs  :
+ *           char *host - The MPD host name or IP address.
+ *           int port   - The MPD port.
+ * Outputs : The number of addresses, -1 on failure.
+ */
+int net_init(const char *host, int port) {
+   int n;
+   uint64_t ttl = 0;
+   struct net_addr addrs[NET_MAX_ADDRS];
+
+   pthread_mutex_lock(&cache.lock);
+   free(cache.host);
+   cache.host = strdup(host);
+   snprintf(cache.port,sizeof(cache.port),"%d",port);
+   cache.count = 0;
+   cache.has_preferred = 0;
+   pthread_mutex_unlock(&cache.lock);
+
+   if (cache.host == NULL) {
+      return -1;
+   }
+
+   n = net_resolve(addrs,&ttl);
+
+   pthread_mutex_lock(&cache.lock);
+   net_store(addrs,n,ttl);
+   pthread_mutex_unlock(&cache.lock);
+
+   return n;
+}
+
+/*
+ * Fuction : net_start
+ * Desc    : A fuction that starts the background resolver. Threads do not
+ *           survive fork(), it is called after the daemon is forked.
+ * Inputs  : None
+ * Outputs : 0 on success, -1 on failure. Errors sent to syslog.
+ */
+int net_start(void) {
+   int rc;
+   pthread_t thread;
+   pthread_condattr_t attr;
+
+   if (cache.running) {
+      return 0;
+   }
+
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr,CLOCK_MONOTONIC);
+   pthread_cond_init(&cache.cond,&attr);
+   pthread_condattr_destroy(&attr);
+
+   rc = pthread_create(&thread,NULL,net_thread,NULL);
+   if (rc != 0) {
+      syslog(LOG_ERR,"Can not start resolver thread: %s",strerror(rc));
+      return -1;
+   }
+   pthread_detach(thread);
+   cache.running = 1;
+
+   return 0;
+}
+
+/*
+ * Fuction : net_lookup
+ * Desc    : A fuction that returns the cached addresses of the MPD host
+ *           without waiting. Expired addresses are still returned while
+ *           the background thread refreshes them. The address that
+ *           connected last is returned first.
+ * Inputs  :
+ *           struct *addrs - Array for the addresses.
+ *           int max       - The size of the array.
+ * Outputs : The number of addresses, 0 when none are known yet.
+ */
+int net_lookup(struct net_addr *addrs, int max) {
+   int i, n;
+   struct net_addr tmp;
+
+   pthread_mutex_lock(&cache.lock);
+
+   n = cache.count < max ? cache.count : max;
+   memcpy(addrs,cache.addrs,n * sizeof(struct net_addr));
+
+   // A failed resolution sets "expires" to its retry time, an empty cache
+   // waits for it like an expired one.
+   if (cache.running && !cache.refresh &&
+       ((cache.count == 0 && cache.expires == 0) ||
+        (cache.expires != 0 && net_clock_ms() >= cache.expires))) {
+      cache.refresh = 1;
+      pthread_cond_signal(&cache.cond);
+   }
+
+   for (i=1; cache.has_preferred && i<n; i++) {
+      if (addrs[i].len == cache.preferred.len &&
+          !memcmp(&addrs[i].sa,&cache.preferred.sa,addrs[i].len)) {
+         tmp = addrs[0];
+         addrs[0] = addrs[i];
+         addrs[i] = tmp;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock(&cache.lock);
+
+   return n;
+}
+
+/*
+ * Fuction : net_prefer
+ * Desc    : A fuction that remembers the address that connected, so that
+ *           the next connection tries it first.
+ * Inputs  : struct *addr - The address.
+ * Outputs : None
+ */
+void net_prefer(const struct net_addr *addr) {
+   pthread_mutex_lock(&cache.lock);
+   cache.preferred = *addr;
+   cache.has_preferred = 1;
+   pthread_mutex_unlock(&cache.lock);
+}
+
+/*
+ * Fuction : net_attempt
+ * Desc    : A fuction that starts a non blocking connect.
+ * Inputs  :
+ *           struct *addr - The address.
+ *           int *done    - Set to 1 when the connect finished at once.
+ * Outputs : The socket, -1 when the attempt failed at once.
+ */
+static int net_attempt(const struct net_addr *addr, int *done) {
+   int fd;
+
+   *done = 0;
+
+   fd = socket(addr->sa.ss_family,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+               0);
+   if (fd < 0) {
+      return -1;
+   }
+
+   if (connect(fd,(const struct sockaddr *)&addr->sa,addr->len) == 0) {
+      *done = 1;
+      return fd;
+   }
+   if (errno != EINPROGRESS) {
+      close(fd);
+      return -1;
+   }
+
+   return fd;
+}
+
+/*
+ * Fuction : net_connect
+ * Desc    : A fuction that connects to the first address that answers. The
+ *           address families are tried in turn (RFC 8305 "Happy Eyeballs"),
+ *           the next attempt starts after NET_ATTEMPT_DELAY_MS or as soon
+ *           as an attempt fails, earlier attempts are kept running.
+ * Inputs  :
+ *           struct *addrs  - The addresses, the first is tried first.
+ *           int n          - The number of addresses.
+ *           int timeout_ms - The time allowed for all attempts.
+ *           int *winner    - Set to the index of the connected address.
+ * Outputs : The connected non blocking socket, -1 on failure with errno set.
+ */
+int net_connect(const struct net_addr *addrs, int n, int timeout_ms,
+                int *winner) {
+   int i, j, fd, done, err;
+   int started = 0;
+   int pending = 0;
+   int result = -1;
+   int family, same, other;
+   int first[NET_MAX_ADDRS];
+   int second[NET_MAX_ADDRS];
+   int order[NET_MAX_ADDRS];
+   int fds[NET_MAX_ADDRS];
+   int wait;
+   uint64_t now, deadline, next;
+   socklen_t len;
+   struct pollfd pfds[NET_MAX_ADDRS];
+   int pidx[NET_MAX_ADDRS];
+
+   if (n > NET_MAX_ADDRS) {
+      n = NET_MAX_ADDRS;
+   }
+   if (n <= 0) {
+      errno = EHOSTUNREACH;
+      return -1;
+   }
+
+   // Interleave the address families, keeping the order within a family.
+   family = addrs[0].sa.ss_family;
+   for (i=0, same=0, other=0; i<n; i++) {
+      if (addrs[i].sa.ss_family == family) {
+         first[same++] = i;
+      } else {
+         second[other++] = i;
+      }
+   }
+   for (i=0, j=0; j<n; i++) {
+      if (i < same) {
+         order[j++] = first[i];
+      }
+      if (i < other) {
+         order[j++] = second[i];
+      }
+   }
+
+   for (i=0; i<n; i++) {
+      fds[i] = -1;
+   }
+
+   err = ETIMEDOUT;
+   now = net_clock_ms();
+   deadline = now + timeout_ms;
+   next = now;
+
+   while (result < 0) {
+      now = net_clock_ms();
+
+      if (started < n && (pending == 0 || now >= next)) {
+         i = order[started++];
+         fds[i] = net_attempt(&addrs[i],&done);
+         if (fds[i] < 0) {
+            err = errno;
+            continue;
+         }
+         if (done) {
+            result = i;
+            break;
+         }
+         pending++;
+         next = now + NET_ATTEMPT_DELAY_MS;
+         continue;
+      }
+
+      if (pending == 0 || now >= deadline) {
+         break;
+      }
+
+      wait = deadline - now;
+      if (started < n && next - now < (uint64_t)wait) {
+         wait = next - now;
+      }
+
+      for (i=0, j=0; i<n; i++) {
+         if (fds[i] >= 0) {
+            pfds[j].fd = fds[i];
+            pfds[j].events = POLLOUT;
+            pfds[j].revents = 0;
+            pidx[j++] = i;
+         }
+      }
+
+      if (poll(pfds,j,wait) < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         err = errno;
+         break;
+      }
+
+      for (i=0; i<j; i++) {
+         if (pfds[i].revents == 0) {
+            continue;
+         }
+         fd = pfds[i].fd;
+         len = sizeof(done);
+         if (getsockopt(fd,SOL_SOCKET,SO_ERROR,&done,&len) == 0 &&
+             done == 0) {
+            result = pidx[i];
+            break;
+         }
+         err = done ? done : errno;
+         close(fd);
+         fds[pidx[i]] = -1;
+         pending--;
+         // Start the next attempt right away.
+         next = now;
+      }
+   }
+
+   for (i=0; i<n; i++) {
+      if (fds[i] >= 0 && i != result) {
+         close(fds[i]);
+      }
+   }
+
+   if (result < 0) {
+      errno = err;
+      return -1;
+   }
+
+   *winner = result;
+   return fds[result];
+}
+
+/*
+ * Fuction : net_read_line
+ * Desc    : A fuction that reads one line, like the MPD welcome line, from a
+ *           non blocking socket.
+ * Inputs  :
+ *           int fd         - The socket.
+ *           char *line     - The buffer, the line is stored without "\n".
+ *           int size       - The size of the buffer.
+ *           int timeout_ms - The time allowed to read the line.
+ * Outputs : 0 on success, -1 on failure with errno set.
+ */
+int net_read_line(int fd, char *line, int size, int timeout_ms) {
+   int len = 0;
+   int rc;
+   uint64_t deadline = net_clock_ms() + timeout_ms;
+   uint64_t now;
+   struct pollfd pfd;
+
+   while (len < size - 1) {
+      rc = recv(fd,&line[len],1,0);
+      if (rc == 1) {
+         if (line[len] == '\n') {
+            line[len] = '\0';
+            return 0;
+         }
+         len++;
+         continue;
+      }
+      if (rc == 0) {
+         errno = ECONNRESET;
+         return -1;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+         return -1;
+      }
+
+      now = net_clock_ms();
+      if (now >= deadline) {
+         errno = ETIMEDOUT;
+         return -1;
+      }
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      poll(&pfd,1,deadline - now);
+   }
+
+   errno = EPROTO;
+   return -1;
+}
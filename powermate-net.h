@@ -0,0 +1,58 @@
+/* powermate-net.h
+* MPD host name resolution and connection for Powermate-mpd.
+*
+* Version: 2.1.0
+* Author:  Matthew J Wolf
+* Date:    19-OCT-2026
+* This file is part of Powermate-mpd.
+* By Matthew J. Wolf <mwolf@speciosus.net>
+* Copyright 2018 Matthew J. Wolf
+*
+* Powermate-mpd is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by the
+* the Free Software Foundation,either version 2 of the License,
+* or (at your option) any later version.
+*
+* Powermate-mpd is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with the HPSDR-USB Plug-in for Wireshark.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#ifndef POWERMATE_NET_H
+#define POWERMATE_NET_H
+
+#include <sys/socket.h>
+
+#define NET_MAX_ADDRS 8
+
+// Cache lifetime of resolved addresses. The DNS TTL is used when the name
+// comes from DNS, NET_DEFAULT_TTL_MS when it does not (e.g. /etc/hosts).
+#define NET_DEFAULT_TTL_MS 300000
+#define NET_MIN_TTL_MS     1000
+#define NET_MAX_TTL_MS     3600000
+// Retry interval of a failed background resolution.
+#define NET_RETRY_MS       5000
+
+// Delay before the next address is tried while an attempt is pending.
+#define NET_ATTEMPT_DELAY_MS 250
+#define NET_CONNECT_TIMEOUT_MS 5000
+
+struct net_addr {
+   struct sockaddr_storage sa;
+   socklen_t len;
+};
+
+int net_init(const char *host, int port);
+int net_start(void);
+int net_lookup(struct net_addr *addrs, int max);
+void net_prefer(const struct net_addr *addr);
+int net_connect(const struct net_addr *addrs, int n, int timeout_ms,
+                int *winner);
+int net_read_line(int fd, char *line, int size, int timeout_ms);
+
+#endif
@@ -0,0 +1,215 @@
+/* powermate-state.c
+ * Shared memory publication of the MPD state seen by Powermate-mpd.
+ *
+ * Version: 2.1.0
+ * Author:  Matthew J Wolf
+ * Date:    19-OCT-2026
+ *  This file is part of Powermate-mpd.
+ * By Matthew J. Wolf <mwolf@speciosus.net>
+ * Copyright 2018 Matthew J. Wolf
+ *
+ * Powermate-mpd is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * the Free Software Foundation,either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Powermate-mpd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the HPSDR-USB Plug-in for Wireshark.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "./powermate-state.h"
+
+static struct powermate_state *shared_state = NULL;
+
+// The MPD worker thread publishes, the main thread closes. The lock keeps
+// an update and state_close apart.
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Fuction : state_begin
+ * Desc    : A fuction that starts a seqlock update of the state.
+ * Inputs  : None
+ * Outputs : The sequence number to pass to state_end.
+ */
+static uint32_t state_begin(void) {
+   uint32_t seq = shared_state->seq;
+
+   __atomic_store_n(&shared_state->seq,seq+1,__ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   return seq;
+}
+
+/*
+ * Fuction : state_end
+ * Desc    : A fuction that ends a seqlock update of the state.
+ * Inputs  : uint32_t seq - The value returned by state_begin.
+ * Outputs : None
+ */
+static void state_end(uint32_t seq) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+   shared_state->updated_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+   __atomic_store_n(&shared_state->seq,seq+2,__ATOMIC_RELEASE);
+}
+
+/*
+ * Fuction : state_open
+ * Desc    : A fuction that creates and maps the state file.
+ * Inputs  : char *path - The state file.
+ * Outputs : 0 on success, -1 on failure. Errors sent to syslog.
+ */
+int state_open(const char *path) {
+   int fd;
+   void *map;
+   uint32_t seq;
+
+   if (shared_state != NULL) {
+      munmap(shared_state,sizeof(struct powermate_state));
+      shared_state = NULL;
+   }
+
+   fd = open(path, O_RDWR | O_CREAT,
+             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+   if (fd < 0) {
+      syslog(LOG_WARNING,"Can not open state file %s: %s",path,
+             strerror(errno));
+      return -1;
+   }
+
+   if (ftruncate(fd,sizeof(struct powermate_state)) < 0) {
+      syslog(LOG_WARNING,"Can not size state file %s: %s",path,
+             strerror(errno));
+      close(fd);
+      return -1;
+   }
+
+   map = mmap(NULL,sizeof(struct powermate_state),PROT_READ | PROT_WRITE,
+              MAP_SHARED,fd,0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      syslog(LOG_WARNING,"Can not map state file %s: %s",path,
+             strerror(errno));
+      return -1;
+   }
+
+   shared_state = map;
+
+   // Keep the sequence number of an earlier run so readers see a change.
+   if (memcmp(shared_state->magic,STATE_MAGIC,sizeof(shared_state->magic)) ||
+       shared_state->version != STATE_VERSION) {
+      memset(shared_state,0,sizeof(struct powermate_state));
+      memcpy(shared_state->magic,STATE_MAGIC,sizeof(shared_state->magic));
+      shared_state->version = STATE_VERSION;
+   }
+
+   // An update of an earlier run may have been cut short.
+   if (shared_state->seq & 1) {
+      shared_state->seq++;
+   }
+
+   seq = state_begin();
+   shared_state->state = 0;
+   shared_state->volume = -1;
+   shared_state->song_id = -1;
+   shared_state->elapsed_ms = 0;
+   shared_state->elapsed_at_ms = 0;
+   shared_state->connected = 0;
+   shared_state->failures = 0;
+   state_end(seq);
+
+   return 0;
+}
+
+/*
+ * Fuction : state_close
+ * Desc    : A fuction that publishes that the daemon is gone. The file is
+ *           left in place with "connected" cleared. Later updates are
+ *           skipped, the MPD worker thread may still run. The page stays
+ *           mapped until the process exits.
+ * Inputs  : None
+ * Outputs : None
+ */
+void state_close(void) {
+   uint32_t seq;
+
+   pthread_mutex_lock(&state_lock);
+   if (shared_state != NULL) {
+      seq = state_begin();
+      shared_state->connected = 0;
+      state_end(seq);
+      shared_state = NULL;
+   }
+   pthread_mutex_unlock(&state_lock);
+}
+
+/*
+ * Fuction : state_publish
+ * Desc    : A fuction that publishes a MPD status the daemon received. The
+ *           time it was received is stored next to "elapsed_ms".
+ * Inputs  :
+ *           int state           - libmpdclient "enum mpd_state".
+ *           int volume          - The volume, -1 when there is no mixer.
+ *           int song_id         - The current song id, -1 when none.
+ *           unsigned elapsed_ms - The play time of the current song.
+ * Outputs : None
+ */
+void state_publish(int state, int volume, int song_id, unsigned elapsed_ms) {
+   uint32_t seq;
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME,&ts);
+
+   pthread_mutex_lock(&state_lock);
+   if (shared_state != NULL) {
+      seq = state_begin();
+      shared_state->state = state;
+      shared_state->volume = volume;
+      shared_state->song_id = song_id;
+      shared_state->elapsed_ms = elapsed_ms;
+      shared_state->elapsed_at_ms = (int64_t)ts.tv_sec * 1000 +
+                                    ts.tv_nsec / 1000000;
+      shared_state->connected = 1;
+      shared_state->failures = 0;
+      state_end(seq);
+   }
+   pthread_mutex_unlock(&state_lock);
+}
+
+/*
+ * Fuction : state_publish_failure
+ * Desc    : A fuction that publishes a failed MPD contact. The last known
+ *           player state is kept.
+ * Inputs  : None
+ * Outputs : None
+ */
+void state_publish_failure(void) {
+   uint32_t seq;
+
+   pthread_mutex_lock(&state_lock);
+   if (shared_state != NULL) {
+      seq = state_begin();
+      shared_state->connected = 0;
+      shared_state->failures++;
+      state_end(seq);
+   }
+   pthread_mutex_unlock(&state_lock);
+}
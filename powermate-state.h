@@ -0,0 +1,107 @@
+/* powermate-state.h
+* Shared memory publication of the MPD state seen by Powermate-mpd.
+*
+* Version: 2.1.0
+* Author:  Matthew J Wolf
+* Date:    19-OCT-2026
+* This file is part of Powermate-mpd.
+* By Matthew J. Wolf <mwolf@speciosus.net>
+* Copyright 2018 Matthew J. Wolf
+*
+* Powermate-mpd is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by the
+* the Free Software Foundation,either version 2 of the License,
+* or (at your option) any later version.
+*
+* Powermate-mpd is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied
+* warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+* See the GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with the HPSDR-USB Plug-in for Wireshark.
+* If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#ifndef POWERMATE_STATE_H
+#define POWERMATE_STATE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define STATEFILE "/usr/local/var/run/powermate-mpd.state"
+
+#define STATE_MAGIC "PMMPDST"
+#define STATE_VERSION 2
+
+// Odd "seq" reads before powermate_state_read gives up, some milliseconds.
+// An update takes well under a microsecond.
+#define STATE_READ_SPINS (1U << 22)
+
+// The file holds one powermate_state structure. The daemon is the only
+// writer, it updates the file as soon as MPD reports a player or mixer
+// change. "seq" is odd while the daemon writes and is increased by two for
+// every update, readers copy the structure with powermate_state_read.
+// While "state" is play the current play time is
+// elapsed_ms + (CLOCK_REALTIME ms - elapsed_at_ms).
+struct powermate_state {
+   char magic[8];
+   uint32_t version;
+   uint32_t seq;
+   int32_t state;        // libmpdclient "enum mpd_state"
+   int32_t volume;       // -1 when MPD has no mixer
+   int32_t song_id;      // -1 when there is no current song
+   uint32_t elapsed_ms;  // Play time of the song at "elapsed_at_ms"
+   uint32_t connected;   // 1 when the last MPD contact worked
+   uint32_t failures;    // Failed MPD contacts since the last good one
+   uint64_t updated_ns;  // CLOCK_MONOTONIC of the last update
+   int64_t elapsed_at_ms; // CLOCK_REALTIME ms when MPD reported elapsed_ms
+};
+
+int state_open(const char *path);
+void state_close(void);
+void state_publish(int state, int volume, int song_id, unsigned elapsed_ms);
+void state_publish_failure(void);
+
+/*
+ * Fuction : powermate_state_read
+ * Desc    : A fuction that takes a consistent copy of the mapped state
+ *           without locks or system calls. It is for the programs that
+ *           read the state file. The caller checks with fstat() that the
+ *           file holds at least sizeof(struct powermate_state) bytes before
+ *           it maps it, a short file raises SIGBUS. The caller also checks
+ *           "magic" and "version" of the copy. A daemon that died in the
+ *           middle of an update leaves "seq" odd, the fuction gives up after
+ *           STATE_READ_SPINS odd reads instead of waiting for it.
+ * Inputs  :
+ *           struct *shared - The mapped state file.
+ *           struct *copy   - The copy.
+ *           uint32_t *seq  - The sequence number of the copy.
+ * Outputs : 0 on success, -1 when the file stayed in the middle of an
+ *           update.
+ */
+static inline int powermate_state_read(const struct powermate_state *shared,
+                                       struct powermate_state *copy,
+                                       uint32_t *seq) {
+   uint32_t seq1, seq2 = 0;
+   uint32_t spins = 0;
+
+   do {
+      seq1 = __atomic_load_n(&shared->seq,__ATOMIC_ACQUIRE);
+      if (seq1 & 1) {
+         if (++spins >= STATE_READ_SPINS) {
+            return -1;
+         }
+         continue;
+      }
+      memcpy(copy,(const void *)shared,sizeof(struct powermate_state));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      seq2 = __atomic_load_n(&shared->seq,__ATOMIC_RELAXED);
+   } while ((seq1 & 1) || seq1 != seq2);
+
+   *seq = seq1;
+
+   return 0;
+}
+
+#endif